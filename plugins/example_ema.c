@@ -0,0 +1,84 @@
+/*
+ * example_ema — Minimal filter plugin for rmpp-stabilizer
+ *
+ * Exponential moving average with a time constant, so it smooths the
+ * same at any report rate. A starting point for new engines: build with
+ *
+ *   make build/aarch64/plugins/example_ema.so
+ *
+ * copy it to /home/root/.stabilizer.d/ and set plugin=example_ema in
+ * the config. Keys: strength (0-1, shared with the built-ins) or
+ * ema_tau_ms to set the time constant directly.
+ *
+ * MIT License
+ */
+
+#include "../src/stabilizer_plugin.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct ema {
+    double tau;             /* seconds */
+    double x, y, p, t;
+    int init;
+};
+
+static void* ema_init(void) {
+    struct ema* e = (struct ema*)calloc(1, sizeof(struct ema));
+    if (e) e->tau = 0.017;
+    return e;
+}
+
+static int ema_params(void* self, const char* key, const char* value) {
+    struct ema* e = (struct ema*)self;
+    if (strcmp(key, "strength") == 0) {
+        double s = atof(value);
+        if (s < 0) s = 0;
+        if (s > 1) s = 1;
+        e->tau = 0.002 + s * 0.03;
+    } else if (strcmp(key, "ema_tau_ms") == 0) {
+        double ms = atof(value);
+        if (ms > 0) e->tau = ms / 1000.0;
+    }
+    return 0;
+}
+
+static int ema_process(void* self, stabilizer_point* pts, size_t n) {
+    struct ema* e = (struct ema*)self;
+    for (size_t i = 0; i < n; i++) {
+        stabilizer_point* pt = &pts[i];
+        if (!e->init) {
+            e->x = pt->x; e->y = pt->y; e->p = pt->pressure; e->t = pt->t;
+            e->init = 1;
+            continue;
+        }
+        double dt = pt->t - e->t;
+        if (!(dt > 0 && dt < 0.1)) dt = 0.002;
+        double a = 1.0 - exp(-dt / e->tau);
+        e->x += a * (pt->x - e->x);
+        e->y += a * (pt->y - e->y);
+        e->p += a * (pt->pressure - e->p);
+        e->t = pt->t;
+        pt->x = e->x; pt->y = e->y; pt->pressure = e->p;
+    }
+    return 0;
+}
+
+static void ema_reset(void* self) {
+    ((struct ema*)self)->init = 0;
+}
+
+static void ema_destroy(void* self) {
+    free(self);
+}
+
+static const stabilizer_plugin ema_plugin = {
+    STABILIZER_PLUGIN_ABI, sizeof(stabilizer_plugin), "example exponential moving average",
+    ema_init, ema_params, ema_process, ema_reset, ema_destroy
+};
+
+const stabilizer_plugin* stabilizer_plugin_v1(void) {
+    return &ema_plugin;
+}
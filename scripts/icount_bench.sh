@@ -0,0 +1,130 @@
+#!/bin/bash
+# rmpp-stabilizer instruction-count benchmark
+# Runs the cross-compiled libstabilizer.so under qemu-aarch64 user-mode
+# with QEMU's instruction-counting plugin (libinsn.so) and reports
+# instructions per frame for each algorithm, compared against the
+# stored baseline. Without a baseline the first run records one, to be
+# committed; after that an algorithm missing from it is a failure.
+#
+# Usage: scripts/icount_bench.sh [--update] [recording.ev ...]
+#   --update   write the current counts as the new baseline
+#
+# Environment:
+#   QEMU              qemu-aarch64 binary (default: qemu-aarch64)
+#   QEMU_SYSROOT      aarch64 sysroot for -L (default: /usr/aarch64-linux-gnu)
+#   QEMU_INSN_PLUGIN  path to libinsn.so (built from QEMU's tests/tcg/plugins,
+#                     tests/plugin on older releases); searched if unset
+#   ICOUNT_TOLERANCE  allowed change vs baseline in percent (default: 1.0)
+
+set -e
+
+QEMU="${QEMU:-qemu-aarch64}"
+SYSROOT="${QEMU_SYSROOT:-/usr/aarch64-linux-gnu}"
+PLUGIN="${QEMU_INSN_PLUGIN:-}"
+TOLERANCE="${ICOUNT_TOLERANCE:-1.0}"
+BASELINE="tools/icount_baseline.txt"
+LIB="./libstabilizer.so"
+DRIVER="build/aarch64/pen_icount"
+ALGORITHMS="moving_avg gaussian string_pull one_euro bezier"
+
+UPDATE=0
+RECORDED=0
+if [ "$1" = "--update" ]; then
+    UPDATE=1
+    shift
+fi
+CORPUS=("$@")
+
+if [ -z "$PLUGIN" ]; then
+    for dir in /usr/lib/qemu/plugins /usr/local/lib/qemu/plugins \
+               /usr/lib/x86_64-linux-gnu/qemu/plugins /usr/libexec/qemu/plugins; do
+        if [ -f "$dir/libinsn.so" ]; then
+            PLUGIN="$dir/libinsn.so"
+            break
+        fi
+    done
+fi
+if ! command -v "$QEMU" >/dev/null; then
+    echo "Error: $QEMU not found (install qemu-user)."
+    exit 1
+fi
+if [ -z "$PLUGIN" ] || [ ! -f "$PLUGIN" ]; then
+    echo "Error: libinsn.so plugin not found. Set QEMU_INSN_PLUGIN."
+    exit 1
+fi
+if [ ! -f "$LIB" ] || [ ! -f "$DRIVER" ]; then
+    echo "Error: $LIB or $DRIVER missing. Run 'make icount'."
+    exit 1
+fi
+
+LOG=$(mktemp)
+trap 'rm -f "$LOG"' EXIT
+
+# Prints "<frames> <instructions>" for one algorithm
+count() {
+    local frames insns
+    frames=$("$QEMU" -L "$SYSROOT" -plugin "$PLUGIN" -d plugin -D "$LOG" \
+             "$DRIVER" "$LIB" "$1" "${CORPUS[@]}" 2>/dev/null)
+    # Newer plugins print per-vCPU lines plus a total; older ones one line
+    insns=$(grep -o 'total insns: [0-9]*' "$LOG" | awk '{print $3}')
+    if [ -z "$insns" ]; then
+        insns=$(grep -o 'insns: [0-9]*' "$LOG" | awk '{s += $2} END {if (NR) print s}')
+    fi
+    echo "$frames $insns"
+}
+
+# Exits unless count() produced a frame count and an instruction count
+check_count() {
+    if [ -z "$2" ] || [ -z "$3" ]; then
+        echo "Error: no instruction count for $1 (plugin log: $(head -c 200 "$LOG"))"
+        exit 1
+    fi
+}
+
+read -r FRAMES BASE_INSNS <<< "$(count off)"
+check_count off "$FRAMES" "$BASE_INSNS"
+if [ ! -f "$BASELINE" ] && [ "$UPDATE" = "0" ]; then
+    echo "No baseline at $BASELINE yet: recording this run."
+    UPDATE=1
+    RECORDED=1
+fi
+echo "=== rmpp-stabilizer instruction counts (aarch64, $FRAMES frames) ==="
+printf "%-12s %12s %12s %9s\n" "algorithm" "insns/frame" "baseline" "delta"
+
+RESULTS=""
+FAILED=0
+for alg in $ALGORITHMS; do
+    read -r frames insns <<< "$(count "$alg")"
+    check_count "$alg" "$frames" "$insns"
+    per_frame=$(awk -v a="$insns" -v b="$BASE_INSNS" -v f="$frames" \
+                'BEGIN {printf "%.1f", (a - b) / f}')
+    RESULTS+="$alg $per_frame"$'\n'
+
+    base=""
+    if [ -f "$BASELINE" ]; then
+        base=$(awk -v a="$alg" '$1 == a {print $2}' "$BASELINE")
+    fi
+    if [ -n "$base" ] && [ "$base" != "0.0" ]; then
+        delta=$(awk -v n="$per_frame" -v o="$base" 'BEGIN {printf "%+.2f%%", (n - o) / o * 100}')
+        over=$(awk -v n="$per_frame" -v o="$base" -v t="$TOLERANCE" \
+               'BEGIN {d = (n - o) / o * 100; print (d > t || d < -t) ? 1 : 0}')
+        [ "$over" = "1" ] && FAILED=1 && delta="$delta !"
+    else
+        base="-"
+        delta="-"
+        [ "$UPDATE" = "0" ] && FAILED=1
+    fi
+    printf "%-12s %12s %12s %9s\n" "$alg" "$per_frame" "$base" "$delta"
+done
+
+if [ "$UPDATE" = "1" ]; then
+    printf "%s" "$RESULTS" > "$BASELINE"
+    echo "Baseline written to $BASELINE"
+    if [ "$RECORDED" = "1" ]; then
+        echo "Commit it so later runs are compared against it."
+    fi
+elif [ "$FAILED" = "1" ]; then
+    echo "Instruction counts changed by more than ${TOLERANCE}% (!) or have no baseline (-)."
+    echo "If intended, run with --update and commit $BASELINE."
+    exit 1
+fi
@@ -17,12 +17,27 @@
 #include <cstring>
 #include <cstdio>
 #include <cstdarg>
+#include <cstdlib>
+#include <climits>
 #include <cmath>
+#include <atomic>
 #include <dlfcn.h>
+#include <link.h>
 #include <linux/input.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "stabilizer_plugin.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -33,13 +48,57 @@
 // ============================================================
 
 static const char* CONFIG_PATH = "/home/root/.stabilizer.conf";
-static const int MAX_HISTORY = 64;
+static const char* PEN_DEVICE_PATH = "/dev/input/event2";
+static const char* PREDICT_PATH = "/home/root/.stabilizer.predict";
+static const char* PLUGIN_DIR = "/home/root/.stabilizer.d";
+
+// History is sized for fast digitizers: 512 entries span 128ms at 4kHz
+// (1s at the rMPP's 500Hz). Power of two so wrapping is a mask.
+static const int MAX_HISTORY = 512;
+static const int HISTORY_MASK = MAX_HISTORY - 1;
+
+// Strength maps to sample counts tuned at the rMPP's report rate; at
+// higher rates the filters scale them to the same time span.
+static const double NOMINAL_RATE_HZ = 500.0;
+static const int GAUSSIAN_MAX_TAPS = 64;
+static const int MAX_PREDICT_TAPS = 8;
+
+// ABS_PRESSURE below this is hover (the rMPP reports no BTN_TOUCH)
+static const int PEN_DOWN_PRESSURE = 50;
+
+// Plugins: frames handed over per process() call, how often the
+// loader thread re-checks when it can't sleep on inotify, default
+// per-frame time budget and how many consecutive overruns drop the
+// plugin.
+static const int PLUGIN_BATCH = 64;
+static const int PLUGIN_POLL_MS = 500;
+static const double PLUGIN_BUDGET_US = 100.0;
+static const int PLUGIN_MAX_OVERRUNS = 3;
+
+// Bézier segments: time unit for the fit (keeps s^6 well scaled), the
+// longest segment before a forced commit, the fewest points a segment
+// holds before it may commit on error, how long output takes to ease
+// onto a new segment, and the smoothing time of the output velocity it
+// eases from.
+static const double BEZIER_TIME_UNIT = 0.1;
+static const double BEZIER_MAX_SPAN = 0.25;
+static const int BEZIER_MIN_POINTS = 6;
+static const double BEZIER_BLEND_SPAN = 0.015;
+static const double BEZIER_VEL_TAU = 0.005;
+
+// Host tools (tools/) point the library at a virtual pen and a scratch
+// config through these; on device neither is set.
+static const char* env_or(const char* name, const char* fallback) {
+    const char* v = getenv(name);
+    return (v && *v) ? v : fallback;
+}
 
 enum Algorithm {
     ALG_MOVING_AVG,
     ALG_GAUSSIAN_AVG,   // Krita-style weighted smoothing
     ALG_STRING_PULL,     // Krita-style stabilizer / delay distance
     ALG_ONE_EURO,        // Casiez et al. 2012
+    ALG_BEZIER,          // Krita-style curve fitting, least squares
     ALG_OFF
 };
 
@@ -48,6 +107,9 @@ struct Config {
     double strength = 0.5;          // 0.0-1.0 master control
     bool pressure_smoothing = false;
     bool tilt_smoothing = false;
+    bool lock_memory = false;       // mlock library pages, prefault on hover
+    bool fault_stats = false;       // log page faults taken inside read()
+    bool prediction = false;        // lag compensation from a fitted table
 
     // Algorithm-specific params (derived from strength)
     int moving_avg_window = 8;
@@ -57,10 +119,32 @@ struct Config {
     double one_euro_mincutoff = 1.0;
     double one_euro_beta = 0.007;
     double one_euro_dcutoff = 1.0;
+    double bezier_tolerance = 20.0;  // RMS and endpoint fit error before committing
 };
 
 static Config g_config;
 
+static const char* algorithm_name(Algorithm a) {
+    switch (a) {
+        case ALG_MOVING_AVG: return "moving_avg";
+        case ALG_GAUSSIAN_AVG: return "gaussian";
+        case ALG_STRING_PULL: return "string_pull";
+        case ALG_ONE_EURO: return "one_euro";
+        case ALG_BEZIER: return "bezier";
+        default: return "off";
+    }
+}
+
+// Linear lag predictor fitted offline by tools/pen_train. The output
+// is pushed forward by a dot product of the last `taps` filtered
+// deltas (rate-normalized) with `coeff`, per axis.
+struct Predictor {
+    int taps = 0;  // 0 = no table loaded
+    double coeff[MAX_PREDICT_TAPS] = {0};
+};
+
+static Predictor g_predictor;
+
 // ============================================================
 // Point history (for Gaussian weighting)
 // ============================================================
@@ -70,6 +154,8 @@ struct Point {
     double pressure = 0;
     double tilt_x = 0, tilt_y = 0;
     double distance = 0;  // distance from previous point
+    double path = 0;      // cumulative stroke length up to this point
+    double t = 0;         // event timestamp, seconds
 };
 
 struct FilterState {
@@ -77,6 +163,12 @@ struct FilterState {
     Point history[MAX_HISTORY];
     int hist_count = 0;
     int hist_head = 0;  // newest entry index
+    double frame_dt = 1.0 / NOMINAL_RATE_HZ;  // smoothed report interval
+
+    // Moving average running sums over the newest ma_count entries.
+    // Inputs are integer evdev values, so the sums stay exact.
+    double ma_sum_x = 0, ma_sum_y = 0;
+    int ma_count = 0;
 
     // String pull state
     double string_x = 0, string_y = 0;
@@ -94,6 +186,31 @@ struct FilterState {
     int raw_tilt_x = 0, raw_tilt_y = 0;
     bool has_x = false, has_y = false;
 
+    // Bézier fit of the open segment. Only fixed-size sums are kept,
+    // relative to the segment start p0 and start tangent d0 (zero
+    // unless the segment joined the previous one smoothly).
+    double bz_p0x = 0, bz_p0y = 0;
+    double bz_d0x = 0, bz_d0y = 0;
+    bool bz_smooth = false;        // d0 fixed: fit a2, a3 only
+    double bz_spow[7] = {0};       // sum of s^k, k = 0..6
+    double bz_vx[4] = {0}, bz_vy[4] = {0};  // sum of r * s^k
+    double bz_rr = 0;              // sum of |r|^2
+    double bz_ax[4] = {0}, bz_ay[4] = {0};  // current fit, power form
+    double bz_s = 0;               // s of the newest point
+    double bz_out_x = 0, bz_out_y = 0;  // last emitted point
+    double bz_vel_x = 0, bz_vel_y = 0;  // and its smoothed velocity, units/s
+    double bz_bx = 0, bz_by = 0;   // blend line after a commit: origin
+    double bz_bvx = 0, bz_bvy = 0; // and slope per unit s
+    bool bz_blend = false;
+    double bz_last_t = 0;
+    int bz_n = 0;
+    bool bz_init = false;
+
+    // Recent filtered outputs feeding the predictor
+    double pred_x[MAX_PREDICT_TAPS + 1], pred_y[MAX_PREDICT_TAPS + 1];
+    double pred_t[MAX_PREDICT_TAPS + 1];
+    int pred_count = 0, pred_head = 0;
+
     // Previous output (for distance calc)
     double prev_x = 0, prev_y = 0;
     bool prev_init = false;
@@ -102,6 +219,7 @@ struct FilterState {
 static FilterState g_state;
 static int g_pen_fd = -1;
 static bool g_active = false;
+static size_t g_stream_skew = 0;  // bytes into a partial event after the last read
 
 // ============================================================
 // Config file reader
@@ -115,13 +233,14 @@ static void derive_params() {
     g_config.string_length = 100.0 + s * 900.0;
     g_config.one_euro_mincutoff = 1.5 - s * 1.3;
     g_config.one_euro_beta = 0.001 + s * 0.01;
+    g_config.bezier_tolerance = 4.0 + s * 36.0;
 }
 
 static void load_config() {
     // Always derive params from defaults first
     derive_params();
 
-    FILE* f = fopen(CONFIG_PATH, "r");
+    FILE* f = fopen(env_or("STABILIZER_CONFIG", CONFIG_PATH), "r");
     if (!f) {
         fprintf(stderr, "[stabilizer] No config file, using defaults: alg=%d strength=%.2f string_len=%.1f\n",
                 g_config.algorithm, g_config.strength, g_config.string_length);
@@ -138,6 +257,7 @@ static void load_config() {
                 else if (strcmp(val, "gaussian") == 0) g_config.algorithm = ALG_GAUSSIAN_AVG;
                 else if (strcmp(val, "string_pull") == 0) g_config.algorithm = ALG_STRING_PULL;
                 else if (strcmp(val, "one_euro") == 0) g_config.algorithm = ALG_ONE_EURO;
+                else if (strcmp(val, "bezier") == 0) g_config.algorithm = ALG_BEZIER;
             }
             else if (strcmp(key, "strength") == 0) {
                 g_config.strength = atof(val);
@@ -150,6 +270,15 @@ static void load_config() {
             else if (strcmp(key, "tilt_smoothing") == 0) {
                 g_config.tilt_smoothing = (strcmp(val, "true") == 0);
             }
+            else if (strcmp(key, "lock_memory") == 0) {
+                g_config.lock_memory = (strcmp(val, "true") == 0);
+            }
+            else if (strcmp(key, "fault_stats") == 0) {
+                g_config.fault_stats = (strcmp(val, "true") == 0);
+            }
+            else if (strcmp(key, "prediction") == 0) {
+                g_config.prediction = (strcmp(val, "true") == 0);
+            }
         }
     }
     fclose(f);
@@ -159,28 +288,113 @@ static void load_config() {
             g_config.algorithm, g_config.strength, g_config.string_length);
 }
 
+// Prediction table (written by tools/pen_train):
+//   algorithm=moving_avg
+//   strength=0.500
+//   taps=4
+//   coeffs=5.18 4.03 0.80 -1.74
+// A table fitted for another algorithm or strength is ignored; the lag
+// it cancels differs.
+static void load_predictor() {
+    g_predictor = Predictor();
+    if (!g_config.prediction) return;
+
+    const char* path = env_or("STABILIZER_PREDICT", PREDICT_PATH);
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "[stabilizer] prediction=true but no table at %s\n", path);
+        return;
+    }
+
+    Predictor p;
+    char alg[64] = "";
+    double strength = -1;
+    int ncoeff = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char key[64], val[192];
+        if (sscanf(line, "%63[^=]=%191[^\n]", key, val) != 2) continue;
+        if (strcmp(key, "algorithm") == 0) {
+            sscanf(val, "%63s", alg);
+        } else if (strcmp(key, "strength") == 0) {
+            strength = atof(val);
+        } else if (strcmp(key, "taps") == 0) {
+            p.taps = atoi(val);
+        } else if (strcmp(key, "coeffs") == 0) {
+            char* cur = val;
+            char* end;
+            ncoeff = 0;
+            while (ncoeff < MAX_PREDICT_TAPS) {
+                double c = strtod(cur, &end);
+                if (end == cur || !std::isfinite(c)) break;
+                p.coeff[ncoeff++] = c;
+                cur = end;
+            }
+        }
+    }
+    fclose(f);
+
+    if (p.taps < 1 || p.taps > MAX_PREDICT_TAPS || ncoeff != p.taps) {
+        fprintf(stderr, "[stabilizer] Ignoring malformed prediction table %s\n", path);
+        return;
+    }
+    if (strcmp(alg, algorithm_name(g_config.algorithm)) != 0) {
+        fprintf(stderr, "[stabilizer] Ignoring prediction table for alg=%s (running %s)\n",
+                alg, algorithm_name(g_config.algorithm));
+        return;
+    }
+    // pen_train writes three decimals
+    if (fabs(strength - g_config.strength) > 0.0005) {
+        fprintf(stderr, "[stabilizer] Ignoring prediction table for strength=%.3f (running %.3f)\n",
+                strength, g_config.strength);
+        return;
+    }
+    g_predictor = p;
+    fprintf(stderr, "[stabilizer] Prediction: %d taps from %s\n", p.taps, path);
+}
+
 // ============================================================
 // History management
 // ============================================================
 
 static void history_push(double x, double y, double pressure,
-                         double tilt_x, double tilt_y) {
+                         double tilt_x, double tilt_y, double timestamp) {
     FilterState& s = g_state;
-    int idx = (s.hist_head + 1) % MAX_HISTORY;
+    int idx = (s.hist_head + 1) & HISTORY_MASK;
     Point& p = s.history[idx];
+
+    // The slot about to be overwritten may still be in the moving-average window
+    if (s.ma_count == MAX_HISTORY) {
+        s.ma_sum_x -= p.x;
+        s.ma_sum_y -= p.y;
+        s.ma_count--;
+    }
+
     p.x = x; p.y = y;
     p.pressure = pressure;
     p.tilt_x = tilt_x; p.tilt_y = tilt_y;
+    p.t = timestamp;
 
     // Compute distance from previous point
     if (s.hist_count > 0) {
         Point& prev = s.history[s.hist_head];
         double dx = x - prev.x, dy = y - prev.y;
         p.distance = sqrt(dx*dx + dy*dy);
+        p.path = prev.path + p.distance;
+
+        // Track the report rate; ignore gaps and clock steps
+        double dt = timestamp - prev.t;
+        if (dt > 0 && dt < 0.1)
+            s.frame_dt += 0.05 * (dt - s.frame_dt);
     } else {
         p.distance = 0;
+        p.path = 0;
     }
 
+    s.ma_sum_x += x;
+    s.ma_sum_y += y;
+    s.ma_count++;
+
     s.hist_head = idx;
     if (s.hist_count < MAX_HISTORY) s.hist_count++;
 }
@@ -188,8 +402,12 @@ static void history_push(double x, double y, double pressure,
 static void history_clear() {
     g_state.hist_count = 0;
     g_state.hist_head = 0;
+    g_state.ma_sum_x = g_state.ma_sum_y = 0;
+    g_state.ma_count = 0;
     g_state.string_init = false;
     g_state.oe_init = false;
+    g_state.bz_init = false;
+    g_state.pred_count = 0;
     g_state.prev_init = false;
     g_state.has_x = false;
     g_state.has_y = false;
@@ -216,13 +434,21 @@ static void gaussian_smooth(double raw_x, double raw_y, double raw_p,
 
     double sum_x = 0, sum_y = 0, sum_p = 0;
     double sum_w = 0;
-    double cum_dist = 0;
 
-    // Walk backward through history, accumulating distance
+    // At report rates above nominal, sample every stride-th point so the
+    // kernel covers the same span with a bounded number of taps.
+    int stride = (int)(1.0 / (NOMINAL_RATE_HZ * s.frame_dt) + 0.5);
+    if (stride < 1) stride = 1;
+    int taps = (s.hist_count + stride - 1) / stride;
+    if (taps > GAUSSIAN_MAX_TAPS) taps = GAUSSIAN_MAX_TAPS;
+
+    // Walk backward through history; distance along the stroke comes
+    // from the cumulative path length
+    double head_path = s.history[s.hist_head].path;
     int idx = s.hist_head;
-    for (int i = 0; i < s.hist_count; i++) {
+    for (int i = 0; i < taps; i++) {
         Point& p = s.history[idx];
-        cum_dist += p.distance;
+        double cum_dist = head_path - p.path + p.distance;
 
         double w = gauss_norm * exp(-cum_dist * cum_dist / (2.0 * sigma2));
 
@@ -234,7 +460,7 @@ static void gaussian_smooth(double raw_x, double raw_y, double raw_p,
         sum_p += w * p.pressure;
         sum_w += w;
 
-        idx = (idx - 1 + MAX_HISTORY) % MAX_HISTORY;
+        idx = (idx - stride) & HISTORY_MASK;
     }
 
     if (sum_w > 0) {
@@ -314,10 +540,15 @@ static void one_euro_filter(double raw_x, double raw_y, double timestamp,
     if (dt <= 0) dt = 0.002; // ~500Hz fallback
     s.oe_last_time = timestamp;
 
-    // Estimate speed via derivative
+    // Estimate speed from how far the output trails the pen over the
+    // time since the last position frame. The gap itself doesn't depend
+    // on the report rate; the interval is held to at least a nominal
+    // period so faster digitizers see the speeds the filter was tuned
+    // for at 500Hz, where this is the original estimate.
     double ad = oe_alpha(c.one_euro_dcutoff, dt);
-    s.oe_dx = oe_lowpass((raw_x - s.oe_x) / dt, s.oe_dx, ad);
-    s.oe_dy = oe_lowpass((raw_y - s.oe_y) / dt, s.oe_dy, ad);
+    double span = dt > 1.0 / NOMINAL_RATE_HZ ? dt : 1.0 / NOMINAL_RATE_HZ;
+    s.oe_dx = oe_lowpass((raw_x - s.oe_x) / span, s.oe_dx, ad);
+    s.oe_dy = oe_lowpass((raw_y - s.oe_y) / span, s.oe_dy, ad);
     double speed = sqrt(s.oe_dx*s.oe_dx + s.oe_dy*s.oe_dy);
 
     // Adaptive cutoff: higher speed → higher cutoff → less smoothing
@@ -333,6 +564,9 @@ static void one_euro_filter(double raw_x, double raw_y, double timestamp,
 
 // ============================================================
 // Algorithm: Simple Moving Average
+// Window is moving_avg_window samples at the nominal rate, held as
+// a time span so faster digitizers average the same duration.
+// Running sums keep it O(1) per frame at any rate.
 // ============================================================
 
 static void moving_avg_filter(double raw_x, double raw_y,
@@ -341,18 +575,255 @@ static void moving_avg_filter(double raw_x, double raw_y,
     int window = g_config.moving_avg_window;
     if (window < 1) window = 1;
 
-    double sx = 0, sy = 0;
-    int n = (s.hist_count < window) ? s.hist_count : window;
-    if (n == 0) { out_x = raw_x; out_y = raw_y; return; }
+    if (s.ma_count == 0) { out_x = raw_x; out_y = raw_y; return; }
+
+    // Half a nominal period of slack keeps exactly `window` samples
+    // at 500Hz despite timestamp rounding. Repeated or rewinding
+    // timestamps (CLOCK_REALTIME steps) would stop the time trim, so
+    // the count is also capped at twice the span in frames at the
+    // current rate, loose enough never to bind on sane timestamps.
+    double span = (window - 0.5) / NOMINAL_RATE_HZ;
+    int max_count = (int)(2.0 * span / s.frame_dt) + 2;
+    double newest = s.history[s.hist_head].t;
+    while (s.ma_count > 1) {
+        Point& oldest = s.history[(s.hist_head - s.ma_count + 1) & HISTORY_MASK];
+        if (newest - oldest.t < span && s.ma_count <= max_count) break;
+        s.ma_sum_x -= oldest.x;
+        s.ma_sum_y -= oldest.y;
+        s.ma_count--;
+    }
+    out_x = s.ma_sum_x / s.ma_count;
+    out_y = s.ma_sum_y / s.ma_count;
+}
 
-    int idx = s.hist_head;
-    for (int i = 0; i < n; i++) {
-        sx += s.history[idx].x;
-        sy += s.history[idx].y;
-        idx = (idx - 1 + MAX_HISTORY) % MAX_HISTORY;
+// ============================================================
+// Algorithm: Least-Squares Cubic Bézier
+// Inspired by Krita's curve-fitting stabilizer. The open segment is
+// the cubic that best fits the stroke since the last commit,
+//   P(s) = p0 + a1 s + a2 s^2 + a3 s^3,  s = time / BEZIER_TIME_UNIT,
+// which is a Bézier with control points p0, p0 + a1/3, ... in power
+// form. The fit is solved from running sums of s^k and r s^k, so it
+// costs the same per frame however long the segment is. Each frame is
+// emitted on the current curve. When the RMS fit error or the distance
+// from the curve's end to the pen passes the tolerance (or the segment
+// gets too long) the segment is committed, and the next one starts at
+// its end, joined with matching tangent unless the segment was too
+// short to be a curve (a corner). A fit of a few points runs through
+// the newest one, so after a commit the output continues along a line
+// from the last emitted point at its smoothed velocity and eases onto
+// the new curve over BEZIER_BLEND_SPAN.
+// ============================================================
+
+static void bezier_start(double p0x, double p0y, double d0x, double d0y,
+                         bool smooth, double t0) {
+    FilterState& s = g_state;
+    s.bz_p0x = p0x; s.bz_p0y = p0y;
+    s.bz_d0x = smooth ? d0x : 0;
+    s.bz_d0y = smooth ? d0y : 0;
+    s.bz_smooth = smooth;
+    s.bz_blend = false;
+    memset(s.bz_spow, 0, sizeof(s.bz_spow));
+    memset(s.bz_vx, 0, sizeof(s.bz_vx));
+    memset(s.bz_vy, 0, sizeof(s.bz_vy));
+    memset(s.bz_ax, 0, sizeof(s.bz_ax));
+    memset(s.bz_ay, 0, sizeof(s.bz_ay));
+    s.bz_ax[1] = s.bz_d0x; s.bz_ay[1] = s.bz_d0y;
+    s.bz_rr = 0;
+    s.bz_s = 0;
+    s.bz_n = 0;
+    s.bz_last_t = t0;
+}
+
+static void bezier_accumulate(double sv, double x, double y) {
+    FilterState& s = g_state;
+    double rx = x - s.bz_p0x - s.bz_d0x * sv;
+    double ry = y - s.bz_p0y - s.bz_d0y * sv;
+    double pk = 1;
+    for (int k = 0; k <= 6; k++) {
+        s.bz_spow[k] += pk;
+        if (k <= 3) {
+            s.bz_vx[k] += rx * pk;
+            s.bz_vy[k] += ry * pk;
+        }
+        pk *= sv;
+    }
+    s.bz_rr += rx * rx + ry * ry;
+    s.bz_n++;
+    s.bz_s = sv;
+}
+
+// Solves the normal equations for the free coefficients (a1..a3, or
+// a2..a3 when the start tangent is fixed). Returns the RMS error.
+static double bezier_solve(double* ax, double* ay) {
+    FilterState& s = g_state;
+    int first = s.bz_smooth ? 2 : 1;
+    int n = 4 - first;
+    double m[3][5];
+    double trace = 0;
+    for (int r = 0; r < n; r++) {
+        for (int c = 0; c < n; c++) m[r][c] = s.bz_spow[first + r + first + c];
+        m[r][n] = s.bz_vx[first + r];
+        m[r][n + 1] = s.bz_vy[first + r];
+        trace += m[r][r];
+    }
+    // Tiny ridge: early in a segment the system is underdetermined
+    for (int r = 0; r < n; r++) m[r][r] += 1e-9 * trace + 1e-12;
+
+    for (int c = 0; c < n; c++) {
+        int piv = c;
+        for (int r = c + 1; r < n; r++)
+            if (fabs(m[r][c]) > fabs(m[piv][c])) piv = r;
+        for (int k = 0; k < n + 2; k++) {
+            double tmp = m[c][k]; m[c][k] = m[piv][k]; m[piv][k] = tmp;
+        }
+        for (int r = c + 1; r < n; r++) {
+            double f = m[r][c] / m[c][c];
+            for (int k = c; k < n + 2; k++) m[r][k] -= f * m[c][k];
+        }
+    }
+    double sol[2][3];
+    for (int rhs = 0; rhs < 2; rhs++) {
+        for (int r = n - 1; r >= 0; r--) {
+            double v = m[r][n + rhs];
+            for (int k = r + 1; k < n; k++) v -= m[r][k] * sol[rhs][k];
+            sol[rhs][r] = v / m[r][r];
+        }
+    }
+
+    ax[0] = 0; ay[0] = 0;
+    ax[1] = s.bz_d0x; ay[1] = s.bz_d0y;
+    for (int r = 0; r < n; r++) {
+        ax[first + r] = sol[0][r];
+        ay[first + r] = sol[1][r];
+    }
+
+    // SSE = sum r^2 - 2 a.v + a^T M a over the free coefficients
+    double sse = s.bz_rr;
+    for (int j = first; j <= 3; j++) {
+        sse -= 2 * (ax[j] * s.bz_vx[j] + ay[j] * s.bz_vy[j]);
+        for (int k = first; k <= 3; k++)
+            sse += (ax[j] * ax[k] + ay[j] * ay[k]) * s.bz_spow[j + k];
+    }
+    return sse > 0 ? sqrt(sse / s.bz_n) : 0;
+}
+
+static void bezier_eval(const double* ax, const double* ay, double sv,
+                        double& x, double& y) {
+    FilterState& s = g_state;
+    x = s.bz_p0x + sv * (ax[1] + sv * (ax[2] + sv * ax[3]));
+    y = s.bz_p0y + sv * (ay[1] + sv * (ay[2] + sv * ay[3]));
+}
+
+static void bezier_filter(double raw_x, double raw_y, double timestamp,
+                          double& out_x, double& out_y) {
+    FilterState& s = g_state;
+
+    if (!s.bz_init) {
+        bezier_start(raw_x, raw_y, 0, 0, false, timestamp);
+        s.bz_init = true;
+        out_x = s.bz_out_x = raw_x;
+        out_y = s.bz_out_y = raw_y;
+        s.bz_vel_x = s.bz_vel_y = 0;
+        return;
     }
-    out_x = sx / n;
-    out_y = sy / n;
+
+    double dt = timestamp - s.bz_last_t;
+    if (!(dt > 0 && dt < 0.1)) dt = s.frame_dt;
+    s.bz_last_t = timestamp;
+    double sv = s.bz_s + dt / BEZIER_TIME_UNIT;
+
+    // Keep the current fit: if this point breaks it, the segment is
+    // committed where the last frame was emitted
+    double prev_ax[4], prev_ay[4];
+    memcpy(prev_ax, s.bz_ax, sizeof(prev_ax));
+    memcpy(prev_ay, s.bz_ay, sizeof(prev_ay));
+    double prev_s = s.bz_s;
+    int prev_n = s.bz_n;
+
+    bezier_accumulate(sv, raw_x, raw_y);
+    double err = bezier_solve(s.bz_ax, s.bz_ay);
+    double ex, ey;
+    bezier_eval(s.bz_ax, s.bz_ay, sv, ex, ey);
+    double end_err = hypot(ex - raw_x, ey - raw_y);
+
+    double tol = g_config.bezier_tolerance;
+    if (prev_n >= BEZIER_MIN_POINTS
+        && (err > tol || end_err > tol || sv * BEZIER_TIME_UNIT > BEZIER_MAX_SPAN)) {
+        // Tangent at the end of the committed segment, per unit s
+        double tx = prev_ax[1] + prev_s * (2 * prev_ax[2] + 3 * prev_s * prev_ax[3]);
+        double ty = prev_ay[1] + prev_s * (2 * prev_ay[2] + 3 * prev_s * prev_ay[3]);
+        bool smooth = prev_n >= 2 * BEZIER_MIN_POINTS;
+        double px, py;
+        bezier_eval(prev_ax, prev_ay, prev_s, px, py);
+        bezier_start(px, py, tx, ty, smooth, timestamp);
+        sv = dt / BEZIER_TIME_UNIT;
+        bezier_accumulate(sv, raw_x, raw_y);
+        bezier_solve(s.bz_ax, s.bz_ay);
+        bezier_eval(s.bz_ax, s.bz_ay, sv, ex, ey);
+        s.bz_bx = s.bz_out_x; s.bz_by = s.bz_out_y;
+        s.bz_bvx = s.bz_vel_x * BEZIER_TIME_UNIT;
+        s.bz_bvy = s.bz_vel_y * BEZIER_TIME_UNIT;
+        s.bz_blend = true;
+    }
+
+    double u = sv * BEZIER_TIME_UNIT / BEZIER_BLEND_SPAN;
+    if (s.bz_blend && u < 1) {
+        double w = u * u * (3 - 2 * u);
+        double lx = s.bz_bx + s.bz_bvx * sv, ly = s.bz_by + s.bz_bvy * sv;
+        ex = lx + w * (ex - lx);
+        ey = ly + w * (ey - ly);
+    }
+    double a = dt / (BEZIER_VEL_TAU + dt);
+    s.bz_vel_x += a * ((ex - s.bz_out_x) / dt - s.bz_vel_x);
+    s.bz_vel_y += a * ((ey - s.bz_out_y) / dt - s.bz_vel_y);
+    out_x = s.bz_out_x = ex;
+    out_y = s.bz_out_y = ey;
+}
+
+// ============================================================
+// Lag compensation: learned linear predictor
+// Every filter trails the pen. Extrapolating the filtered path
+// forward cancels part of that lag while keeping it smooth, since
+// the deltas come from the smoothed signal. Constant-velocity
+// extrapolation is the 1-tap case; pen_train fits more taps by least
+// squares on recorded strokes, which follows curves and slowdowns
+// better. Cost is one short dot product per axis.
+// ============================================================
+
+// Deltas are scaled to the nominal report interval so one table
+// works across rates; must match predict_dt_scale() in tools/pen_train.cpp
+static double predict_dt_scale(double dt) {
+    double nominal = 1.0 / NOMINAL_RATE_HZ;
+    if (dt <= 0) return 1.0;
+    double scale = nominal / dt;
+    if (scale < 0.25) scale = 0.25;
+    if (scale > 4.0) scale = 4.0;
+    return scale;
+}
+
+static void predict(double timestamp, double& x, double& y) {
+    FilterState& s = g_state;
+    const Predictor& p = g_predictor;
+    const int ring = MAX_PREDICT_TAPS + 1;
+
+    s.pred_head = (s.pred_head + 1) % ring;
+    s.pred_x[s.pred_head] = x;
+    s.pred_y[s.pred_head] = y;
+    s.pred_t[s.pred_head] = timestamp;
+    if (s.pred_count < ring) s.pred_count++;
+    if (p.taps == 0 || s.pred_count <= p.taps) return;
+
+    double ox = 0, oy = 0;
+    int i = s.pred_head;
+    for (int k = 0; k < p.taps; k++) {
+        int j = (i + ring - 1) % ring;
+        double scale = predict_dt_scale(s.pred_t[i] - s.pred_t[j]);
+        ox += p.coeff[k] * (s.pred_x[i] - s.pred_x[j]) * scale;
+        oy += p.coeff[k] * (s.pred_y[i] - s.pred_y[j]) * scale;
+        i = j;
+    }
+    x += ox;
+    y += oy;
 }
 
 // ============================================================
@@ -377,6 +848,9 @@ static void apply_filter(double raw_x, double raw_y, double raw_p,
         case ALG_ONE_EURO:
             one_euro_filter(raw_x, raw_y, timestamp, out_x, out_y);
             break;
+        case ALG_BEZIER:
+            bezier_filter(raw_x, raw_y, timestamp, out_x, out_y);
+            break;
         case ALG_OFF:
         default:
             out_x = raw_x; out_y = raw_y;
@@ -384,10 +858,639 @@ static void apply_filter(double raw_x, double raw_y, double raw_p,
     }
 }
 
+// ============================================================
+// Hot-path residency
+// After idle or suspend the first stroke can take page faults on
+// the hook's code and state. lock_memory pins every loaded segment
+// of this library (text, tables, g_state) and re-touches the state
+// when the pen comes into proximity; fault_stats measures what is
+// left with getrusage deltas around the hook.
+// ============================================================
+
+struct FaultStats {
+    long minor = 0, major = 0;              // inside read() this stroke
+    long first_minor = 0, first_major = 0;  // first pen read of the stroke
+    long reads = 0;
+};
+
+static FaultStats g_faults;
+static bool g_locked = false;
+
+static int lock_segments(struct dl_phdr_info* info, size_t, void* self) {
+    uintptr_t addr = (uintptr_t)self;
+    bool ours = false;
+    for (int i = 0; i < info->dlpi_phnum && !ours; i++) {
+        const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+        uintptr_t start = info->dlpi_addr + ph.p_vaddr;
+        ours = ph.p_type == PT_LOAD && addr >= start && addr < start + ph.p_memsz;
+    }
+    if (!ours) return 0;
+
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    size_t locked = 0;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+        if (ph.p_type != PT_LOAD) continue;
+        uintptr_t start = (info->dlpi_addr + ph.p_vaddr) & ~(page - 1);
+        uintptr_t end = info->dlpi_addr + ph.p_vaddr + ph.p_memsz;
+        if (mlock((void*)start, end - start) == 0) {
+            locked += end - start;
+        } else {
+            fprintf(stderr, "[stabilizer] mlock failed: %s\n", strerror(errno));
+            return 1;
+        }
+    }
+    fprintf(stderr, "[stabilizer] Locked %zu bytes of library pages\n", locked);
+    g_locked = true;
+    return 1;
+}
+
+static void lock_library_pages() {
+    if (g_locked) return;
+    dl_iterate_phdr(lock_segments, (void*)&lock_segments);
+}
+
+// Pull filter state and config back into cache before the first
+// contact; pages are already resident once locked.
+static void prefault_hot_state() {
+    const volatile char* p = (const volatile char*)&g_state;
+    for (size_t off = 0; off < sizeof(g_state); off += 64) (void)p[off];
+    p = (const volatile char*)&g_config;
+    for (size_t off = 0; off < sizeof(g_config); off += 64) (void)p[off];
+}
+
+static void account_faults(const struct rusage& before, const struct rusage& after) {
+    long minor = after.ru_minflt - before.ru_minflt;
+    long major = after.ru_majflt - before.ru_majflt;
+    if (g_faults.reads == 0) {
+        g_faults.first_minor = minor;
+        g_faults.first_major = major;
+    }
+    g_faults.minor += minor;
+    g_faults.major += major;
+    g_faults.reads++;
+}
+
+static void report_faults() {
+    if (g_faults.reads > 0) {
+        fprintf(stderr, "[stabilizer] Faults: reads=%ld minor=%ld major=%ld "
+                "first_read minor=%ld major=%ld\n",
+                g_faults.reads, g_faults.minor, g_faults.major,
+                g_faults.first_minor, g_faults.first_major);
+    }
+    g_faults = FaultStats();
+}
+
+// ============================================================
+// Filter plugins
+// Experimental engines ship as shared objects implementing the ABI in
+// stabilizer_plugin.h. A loader thread sleeps on an inotify watch of
+// the config; when the plugin lines change it dlopens and sets up the
+// new plugin off the input path and publishes it through
+// g_plugin_pending. The read hook takes it at the next stroke boundary
+// with one atomic exchange, so no stroke mixes engines, and hands the
+// old one back through g_plugin_retired for the loader to destroy.
+// Calls into a plugin run under a fault guard and a time budget; on a
+// fault, an error return or repeated overruns the hook falls back to
+// the built-in algorithm until the config changes.
+// ============================================================
+
+struct PluginSlot {
+    void* dl = nullptr;                   // null: built-in filters only
+    const stabilizer_plugin* api = nullptr;
+    void* self = nullptr;
+    char name[64] = "";
+    double budget_ns = PLUGIN_BUDGET_US * 1000.0;   // per frame
+    int overruns = 0;
+    bool failed = false;    // dropped, built-in filters take over
+    bool faulted = false;   // crashed: never call into it again
+};
+
+static std::atomic<PluginSlot*> g_plugin_pending{nullptr};
+static std::atomic<PluginSlot*> g_plugin_retired{nullptr};
+static PluginSlot* g_plugin = nullptr;   // read path only
+
+// Config the loader watches; open() may repoint it (host tools)
+static pthread_mutex_t g_plugin_lock = PTHREAD_MUTEX_INITIALIZER;
+static char g_plugin_config_path[256];
+
+// One guard per thread that calls into plugins. A fault raised while
+// the guard is armed jumps back out of the plugin; any other fault is
+// handed to the previous handler.
+struct FaultGuard {
+    pthread_t thread;
+    volatile sig_atomic_t armed = 0;
+    sigjmp_buf env;
+};
+
+static FaultGuard g_read_guard, g_load_guard;
+static const int GUARDED_SIGNALS[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL };
+static const int NUM_GUARDED = sizeof(GUARDED_SIGNALS) / sizeof(GUARDED_SIGNALS[0]);
+static struct sigaction g_prev_actions[NUM_GUARDED];
+
+static void plugin_fault_handler(int sig, siginfo_t* info, void* ctx) {
+    FaultGuard* guards[] = { &g_read_guard, &g_load_guard };
+    for (FaultGuard* g : guards) {
+        if (g->armed && pthread_equal(g->thread, pthread_self())) {
+            g->armed = 0;
+            siglongjmp(g->env, sig);
+        }
+    }
+    // Not ours: hand it to the previous handler and stay installed
+    int i = 0;
+    while (i < NUM_GUARDED && GUARDED_SIGNALS[i] != sig) i++;
+    if (i == NUM_GUARDED) return;
+    const struct sigaction& prev = g_prev_actions[i];
+    if (prev.sa_flags & SA_SIGINFO) {
+        prev.sa_sigaction(sig, info, ctx);
+        return;
+    }
+    // The kernel won't let a real fault be ignored; only a sent one is
+    bool sent = info && info->si_code <= 0;
+    if (prev.sa_handler == SIG_IGN && sent) return;
+    if (prev.sa_handler != SIG_DFL && prev.sa_handler != SIG_IGN) {
+        prev.sa_handler(sig);
+        return;
+    }
+    // Default action: the process dies, so nothing is left to guard
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static void install_fault_handler() {
+    static bool installed = false;   // loader only
+    if (installed) return;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = plugin_fault_handler;
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;   // mask is left as is by the jump
+    sigemptyset(&sa.sa_mask);
+    for (int i = 0; i < NUM_GUARDED; i++)
+        sigaction(GUARDED_SIGNALS[i], &sa, &g_prev_actions[i]);
+    installed = true;
+}
+
+// Runs fn with the guard armed; false if the plugin faulted
+template <typename F>
+static bool guarded(FaultGuard& g, F fn) {
+    g.thread = pthread_self();
+    if (sigsetjmp(g.env, 0) != 0) return false;
+    g.armed = 1;
+    fn();
+    g.armed = 0;
+    return true;
+}
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// ---- Loader thread ----
+
+static void plugin_destroy(PluginSlot* slot) {
+    if (!slot) return;
+    // A plugin that crashed may be in any state; leave it mapped
+    if (slot->self && !slot->faulted && slot->api->destroy) {
+        PluginSlot* p = slot;
+        if (!guarded(g_load_guard, [p] { p->api->destroy(p->self); })) slot->faulted = true;
+    }
+    if (slot->dl && !slot->faulted) dlclose(slot->dl);
+    delete slot;
+}
+
+// Loads <dir>/<name>.so and passes it every key=value line of the
+// config. Returns a built-in slot when name is empty or loading fails.
+static PluginSlot* plugin_open(const char* name, const char* dir, double budget_us,
+                               const char* conf) {
+    PluginSlot* slot = new PluginSlot();
+    if (!name[0]) return slot;
+    if (strchr(name, '/')) {
+        fprintf(stderr, "[stabilizer] Plugin name %s must not contain '/'\n", name);
+        return slot;
+    }
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s.so", dir, name);
+    void* dl = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!dl) {
+        fprintf(stderr, "[stabilizer] Plugin %s: %s\n", name, dlerror());
+        return slot;
+    }
+
+    install_fault_handler();
+    stabilizer_plugin_entry_fn entry = (stabilizer_plugin_entry_fn)dlsym(dl, STABILIZER_PLUGIN_ENTRY);
+    const stabilizer_plugin* api = nullptr;
+    void* self = nullptr;
+    bool ok = entry && guarded(g_load_guard, [&] { api = entry(); });
+    if (ok && (!api || api->abi_version != STABILIZER_PLUGIN_ABI
+               || api->size < sizeof(stabilizer_plugin) || !api->init || !api->process)) {
+        fprintf(stderr, "[stabilizer] Plugin %s: not an ABI v%d plugin\n", path, STABILIZER_PLUGIN_ABI);
+        dlclose(dl);
+        return slot;
+    }
+    char key[64], val[192];
+    bool rejected = false;
+    ok = ok && guarded(g_load_guard, [&] {
+        self = api->init();
+        if (!self || !api->params) return;
+        const char* line = conf;
+        while (*line && !rejected) {
+            if (sscanf(line, "%63[^=\n]=%191[^\n]", key, val) == 2)
+                rejected = api->params(self, key, val) != 0;
+            const char* nl = strchr(line, '\n');
+            line = nl ? nl + 1 : line + strlen(line);
+        }
+    });
+    if (ok && rejected) {
+        fprintf(stderr, "[stabilizer] Plugin %s rejected %s=%s\n", path, key, val);
+        void* p = self;
+        self = nullptr;
+        if (api->destroy && !guarded(g_load_guard, [&] { api->destroy(p); })) ok = false;
+    }
+    if (!ok || !self) {
+        // dlclose could run the crashed plugin's destructors; keep it
+        fprintf(stderr, "[stabilizer] Plugin %s failed to initialize\n", path);
+        if (!self && ok) dlclose(dl);
+        return slot;
+    }
+
+    slot->dl = dl;
+    slot->api = api;
+    slot->self = self;
+    snprintf(slot->name, sizeof(slot->name), "%s", name);
+    if (budget_us > 0) slot->budget_ns = budget_us * 1000.0;
+    fprintf(stderr, "[stabilizer] Plugin %s loaded (%s), budget %.0fus/frame\n",
+            name, api->name ? api->name : "unnamed", slot->budget_ns / 1000.0);
+    return slot;
+}
+
+// Config path and contents last acted on; empty while no plugin is
+// named, so edits to a plugin-free config never reach the read path
+static char g_loader_last[4352], g_loader_cur[sizeof(g_loader_last)];
+
+// One loader pass: re-reads the config and publishes a new slot when
+// the plugin lines changed
+static void plugin_poll() {
+    char* cur = g_loader_cur;
+    plugin_destroy(g_plugin_retired.exchange(nullptr, std::memory_order_acq_rel));
+
+    char path[256];
+    pthread_mutex_lock(&g_plugin_lock);
+    memcpy(path, g_plugin_config_path, sizeof(path));
+    pthread_mutex_unlock(&g_plugin_lock);
+
+    size_t len = (size_t)snprintf(cur, sizeof(g_loader_cur), "%s\n", path);
+    size_t body = len;
+    if (FILE* f = fopen(path, "r")) {
+        len += fread(cur + len, 1, sizeof(g_loader_cur) - len - 1, f);
+        fclose(f);
+    }
+    cur[len] = '\0';
+
+    char name[192] = "", dir[192];
+    double budget_us = 0;
+    snprintf(dir, sizeof(dir), "%s", PLUGIN_DIR);
+    for (const char* line = cur + body; *line; ) {
+        char key[64], val[192];
+        if (sscanf(line, "%63[^=\n]=%191s", key, val) == 2) {
+            if (strcmp(key, "plugin") == 0) snprintf(name, sizeof(name), "%s", val);
+            else if (strcmp(key, "plugin_dir") == 0) snprintf(dir, sizeof(dir), "%s", val);
+            else if (strcmp(key, "plugin_budget_us") == 0) budget_us = atof(val);
+        }
+        const char* nl = strchr(line, '\n');
+        line = nl ? nl + 1 : line + strlen(line);
+    }
+    if (!name[0]) cur[0] = '\0';
+
+    if (strcmp(cur, g_loader_last) != 0) {
+        memcpy(g_loader_last, cur, sizeof(g_loader_last));
+        PluginSlot* slot = plugin_open(name, dir, budget_us, cur + body);
+        // A slot the read path never took is ours to free
+        plugin_destroy(g_plugin_pending.exchange(slot, std::memory_order_acq_rel));
+    }
+}
+
+// Watches the config's directory, so editors that replace the file by
+// renaming are seen too. Returns the watch, or -1 to fall back to
+// polling.
+static int watch_config(int ifd, int wd, const char* path, char* base, size_t base_len) {
+    if (ifd < 0) return -1;
+    if (wd >= 0) inotify_rm_watch(ifd, wd);
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char* slash = strrchr(dir, '/');
+    snprintf(base, base_len, "%s", slash ? slash + 1 : dir);
+    if (!slash) snprintf(dir, sizeof(dir), ".");
+    else if (slash == dir) slash[1] = '\0';
+    else *slash = '\0';
+    return inotify_add_watch(ifd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM
+                                       | IN_CREATE | IN_DELETE);
+}
+
+// Whether any queued inotify event names the config file
+static bool config_touched(int ifd, const char* base) {
+    alignas(struct inotify_event) char buf[4096];
+    bool touched = false;
+    ssize_t n;
+    while ((n = read(ifd, buf, sizeof(buf))) > 0) {
+        for (ssize_t off = 0; off < n; ) {
+            const struct inotify_event* e = (const struct inotify_event*)(buf + off);
+            if ((e->mask & IN_Q_OVERFLOW) || (e->len && strcmp(e->name, base) == 0)) touched = true;
+            off += sizeof(struct inotify_event) + e->len;
+        }
+    }
+    return touched;
+}
+
+static int g_loader_wake = -1;   // eventfd: open() repointed the config
+
+// Sleeps until the config changes. While no plugin is named and none
+// is in flight the thread stays blocked, so a plugin-free session costs
+// nothing after open(). Without inotify it polls every PLUGIN_POLL_MS.
+static void* plugin_loader(void*) {
+    int ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    int wd = -1;
+    char watched[256] = "", base[256] = "";
+    while (true) {
+        char path[256];
+        pthread_mutex_lock(&g_plugin_lock);
+        memcpy(path, g_plugin_config_path, sizeof(path));
+        pthread_mutex_unlock(&g_plugin_lock);
+        if (strcmp(path, watched) != 0) {
+            wd = watch_config(ifd, wd, path, base, sizeof(base));
+            memcpy(watched, path, sizeof(watched));
+            plugin_poll();   // edits made before the watch was in place
+        }
+
+        // A slot the read path hasn't taken, or one it handed back, is
+        // checked on a timer until it's settled
+        bool in_flight = g_plugin_pending.load(std::memory_order_acquire)
+                         || g_plugin_retired.load(std::memory_order_acquire);
+        struct pollfd fds[2] = { { ifd, POLLIN, 0 }, { g_loader_wake, POLLIN, 0 } };
+        int ready = poll(fds, 2, (wd < 0 || in_flight) ? PLUGIN_POLL_MS : -1);
+        bool changed = ready == 0 && wd < 0;
+        if (fds[0].revents & POLLIN) changed = config_touched(ifd, base) || changed;
+        if (fds[1].revents & POLLIN) {
+            uint64_t v;
+            if (read(g_loader_wake, &v, sizeof(v)) == sizeof(v)) changed = true;
+        }
+        if (changed) plugin_poll();
+        else plugin_destroy(g_plugin_retired.exchange(nullptr, std::memory_order_acq_rel));
+    }
+    return nullptr;
+}
+
+// Called from each open() of the pen. The first plugin is loaded right
+// here so the session starts with it; after that the loader thread
+// picks up config edits, including a first plugin= line, live.
+static void start_plugin_loader(const char* config_path) {
+    pthread_mutex_lock(&g_plugin_lock);
+    snprintf(g_plugin_config_path, sizeof(g_plugin_config_path), "%s", config_path);
+    pthread_mutex_unlock(&g_plugin_lock);
+
+    static bool started = false;
+    if (started) {
+        uint64_t one = 1;
+        ssize_t n = write(g_loader_wake, &one, sizeof(one));
+        (void)n;
+        return;
+    }
+    plugin_poll();
+    g_loader_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    // Leave xochitl's signals to its own threads
+    sigset_t all, old;
+    sigfillset(&all);
+    for (int i = 0; i < NUM_GUARDED; i++) sigdelset(&all, GUARDED_SIGNALS[i]);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    started = pthread_create(&thread, &attr, plugin_loader, nullptr) == 0;
+    pthread_attr_destroy(&attr);
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    if (!started) fprintf(stderr, "[stabilizer] Plugin loader thread failed to start\n");
+}
+
+// ---- Read path ----
+
+static stabilizer_point g_batch[PLUGIN_BATCH];
+static stabilizer_point g_batch_raw[PLUGIN_BATCH];
+static double g_batch_tilt[PLUGIN_BATCH][2];   // for history, pushed on flush
+static size_t g_batch_begin[PLUGIN_BATCH], g_batch_end[PLUGIN_BATCH];  // event range
+static int g_batch_count = 0;
+
+static bool plugin_ready() {
+    return g_plugin && g_plugin->api && !g_plugin->failed;
+}
+
+static void plugin_drop(const char* why) {
+    g_plugin->failed = true;
+    fprintf(stderr, "[stabilizer] Plugin %s %s, falling back to alg=%s\n",
+            g_plugin->name, why, algorithm_name(g_config.algorithm));
+}
+
+// Takes a newly loaded plugin at a stroke boundary. Waits for the next
+// boundary while the loader hasn't freed the previous one yet.
+static void plugin_swap() {
+    if (!g_plugin_pending.load(std::memory_order_relaxed)) return;
+    if (g_plugin) {
+        PluginSlot* empty = nullptr;
+        if (!g_plugin_retired.compare_exchange_strong(empty, g_plugin, std::memory_order_acq_rel))
+            return;
+    }
+    g_plugin = g_plugin_pending.exchange(nullptr, std::memory_order_acq_rel);
+    g_batch_count = 0;
+    if (g_plugin->api)
+        fprintf(stderr, "[stabilizer] Plugin %s active\n", g_plugin->name);
+    else
+        fprintf(stderr, "[stabilizer] No plugin, using alg=%s\n", algorithm_name(g_config.algorithm));
+}
+
+static void plugin_reset() {
+    if (!plugin_ready() || !g_plugin->api->reset) return;
+    PluginSlot* p = g_plugin;
+    if (!guarded(g_read_guard, [p] { p->api->reset(p->self); })) {
+        p->faulted = true;
+        plugin_drop("faulted in reset");
+    }
+}
+
+static void plugin_enqueue(double x, double y, double p, double tilt_x, double tilt_y,
+                           double t, size_t begin, size_t end) {
+    stabilizer_point& pt = g_batch_raw[g_batch_count];
+    pt.x = x; pt.y = y; pt.pressure = p; pt.t = t;
+    g_batch_tilt[g_batch_count][0] = tilt_x;
+    g_batch_tilt[g_batch_count][1] = tilt_y;
+    g_batch_begin[g_batch_count] = begin;
+    g_batch_end[g_batch_count] = end;
+    g_batch_count++;
+}
+
+// Filters the queued frames in place in g_batch. False when the plugin
+// was dropped and the frames need the built-in filter instead.
+static bool plugin_process() {
+    PluginSlot* p = g_plugin;
+    size_t n = g_batch_count;
+    memcpy(g_batch, g_batch_raw, n * sizeof(stabilizer_point));
+
+    int rc = 0;
+    double t0 = now_ns();
+    bool ok = guarded(g_read_guard, [p, n, &rc] { rc = p->api->process(p->self, g_batch, n); });
+    double elapsed = now_ns() - t0;
+    if (!ok) {
+        p->faulted = true;
+        plugin_drop("faulted");
+        return false;
+    }
+    if (rc != 0) {
+        plugin_drop("returned an error");
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!std::isfinite(g_batch[i].x) || !std::isfinite(g_batch[i].y)
+            || !std::isfinite(g_batch[i].pressure)) {
+            plugin_drop("returned a non-finite point");
+            return false;
+        }
+    }
+    // One slow batch can be preemption; this batch's output is still used
+    if (elapsed > p->budget_ns * n) {
+        if (++p->overruns >= PLUGIN_MAX_OVERRUNS) plugin_drop("overran its time budget");
+    } else {
+        p->overruns = 0;
+    }
+    return true;
+}
+
 // ============================================================
 // LD_PRELOAD hooks
 // ============================================================
 
+#ifdef STABILIZER_CHECK_FINITE
+// Debug builds (make fuzz) count non-finite filter outputs so the fuzz
+// target can flag the input that produced one
+extern "C" {
+__attribute__((visibility("default"))) unsigned long stabilizer_nonfinite_outputs = 0;
+}
+#endif
+
+// Curve fitting and prediction can extrapolate; keep the written
+// value inside the event field. A non-finite value (a filter bug) has
+// no integer to convert to, so the raw value passes through instead.
+static int to_event_value(double v, double raw) {
+    if (!std::isfinite(v)) {
+#ifdef STABILIZER_CHECK_FINITE
+        stabilizer_nonfinite_outputs++;
+#endif
+        return (int)raw;
+    }
+    if (v > INT_MAX) return INT_MAX;
+    if (v < INT_MIN) return INT_MIN;
+    return (int)v;
+}
+
+// Writes filtered values into the events of one frame, [begin, end]
+static void write_frame(struct input_event* events, size_t begin, size_t end,
+                        double rx, double ry, double rp,
+                        double fx, double fy, double fp) {
+    for (size_t k = begin; k <= end; k++) {
+        if (events[k].type == EV_ABS) {
+            if (events[k].code == ABS_X)
+                events[k].value = to_event_value(fx + 0.5, rx);
+            else if (events[k].code == ABS_Y)
+                events[k].value = to_event_value(fy + 0.5, ry);
+            else if (events[k].code == ABS_PRESSURE
+                     && g_config.pressure_smoothing)
+                events[k].value = to_event_value(fp + 0.5, rp);
+        }
+    }
+}
+
+// Built-in algorithm plus prediction for one point
+static void filter_point(double rx, double ry, double rp, double ts,
+                         double& fx, double& fy, double& fp) {
+    apply_filter(rx, ry, rp, ts, fx, fy, fp);
+    // The table is fitted on pen-down strokes only. Hover frames pass
+    // through unpredicted and keep the ring empty, so a stroke's first
+    // prediction comes from its own points, not the approach
+    if (g_predictor.taps > 0) {
+        if (rp < PEN_DOWN_PRESSURE) g_state.pred_count = 0;
+        else predict(ts, fx, fy);
+    }
+}
+
+// A plugin dropped mid-stroke leaves the rest of the stroke to the
+// built-in filter. Moving average and Gaussian read the history, which
+// already holds the stroke. String pull, 1€ and Bézier carry state
+// instead, so they (and the predictor ring) are run over the history
+// here and continue from where they would be, not restart at the pen.
+// Strokes longer than MAX_HISTORY replay only their newest frames.
+static void builtin_catch_up() {
+    FilterState& s = g_state;
+    Algorithm alg = g_config.algorithm;
+    if (alg == ALG_MOVING_AVG || alg == ALG_GAUSSIAN_AVG) return;
+    s.string_init = false;
+    s.oe_init = false;
+    s.bz_init = false;
+    s.pred_count = 0;
+    for (int k = s.hist_count - 1; k >= 0; k--) {
+        const Point& p = s.history[(s.hist_head - k) & HISTORY_MASK];
+        double fx, fy, fp;
+        filter_point(p.x, p.y, p.pressure, p.t, fx, fy, fp);
+    }
+}
+
+// Built-in path: filter one frame and write it back
+static void filter_frame(struct input_event* events, size_t begin, size_t end,
+                         double rx, double ry, double rp, double ts) {
+    double fx, fy, fp;
+    filter_point(rx, ry, rp, ts, fx, fy, fp);
+
+    // Debug: log every 100ms of pen time to show filtering is
+    // working (a frame count would flood stderr at 4kHz)
+    static double debug_next = 0;
+    if (ts >= debug_next || ts < debug_next - 1.0) {
+        debug_next = ts + 0.1;
+        fprintf(stderr, "[stab] raw=(%.0f,%.0f) filtered=(%.0f,%.0f) delta=(%.1f,%.1f)\n",
+                rx, ry, fx, fy, fx - rx, fy - ry);
+    }
+
+    write_frame(events, begin, end, rx, ry, rp, fx, fy, fp);
+}
+
+// Sends queued frames through the plugin and writes them back. If the
+// plugin is dropped, the built-in filter takes these frames instead.
+// History is pushed frame by frame here rather than on enqueue, so a
+// fallback sees each frame with the history it would have had.
+static void flush_plugin_batch(struct input_event* events) {
+    if (g_batch_count == 0) return;
+    bool ok = plugin_process();
+    if (!ok) builtin_catch_up();
+    for (int i = 0; i < g_batch_count; i++) {
+        const stabilizer_point& r = g_batch_raw[i];
+        history_push(r.x, r.y, r.pressure, g_batch_tilt[i][0], g_batch_tilt[i][1], r.t);
+        if (ok)
+            write_frame(events, g_batch_begin[i], g_batch_end[i], r.x, r.y, r.pressure,
+                        g_batch[i].x, g_batch[i].y, g_batch[i].pressure);
+        else
+            filter_frame(events, g_batch_begin[i], g_batch_end[i], r.x, r.y, r.pressure, r.t);
+    }
+    g_batch_count = 0;
+    // Dropped for overrunning, after this batch's output was used
+    if (ok && !plugin_ready()) builtin_catch_up();
+}
+
+// Pen lifted or left proximity: nothing in flight, safe to switch engines
+static void stroke_boundary(struct input_event* events) {
+    flush_plugin_batch(events);
+    plugin_reset();
+    plugin_swap();
+}
+
 typedef int (*open_func_t)(const char*, int, ...);
 typedef ssize_t (*read_func_t)(int, void*, size_t);
 
@@ -404,7 +1507,7 @@ static void init_hooks() {
 static bool is_pen_device(const char* path) {
     if (!path) return false;
     // RMPP: "Elan marker input" = /dev/input/event2
-    return (strcmp(path, "/dev/input/event2") == 0);
+    return (strcmp(path, env_or("STABILIZER_PEN_DEVICE", PEN_DEVICE_PATH)) == 0);
 }
 
 extern "C" int open(const char* pathname, int flags, ...) {
@@ -424,7 +1527,14 @@ extern "C" int open(const char* pathname, int flags, ...) {
     if (fd >= 0 && is_pen_device(pathname)) {
         g_pen_fd = fd;
         g_active = true;
+        g_stream_skew = 0;
         load_config();
+        load_predictor();
+        if (g_config.lock_memory) lock_library_pages();
+        g_batch_count = 0;
+        plugin_reset();
+        start_plugin_loader(env_or("STABILIZER_CONFIG", CONFIG_PATH));
+        plugin_swap();
         fprintf(stderr, "[stabilizer] Intercepting: %s (fd=%d) alg=%d\n",
                 pathname, fd, g_config.algorithm);
     }
@@ -436,13 +1546,32 @@ extern "C" ssize_t read(int fd, void* buf, size_t count) {
     init_hooks();
     ssize_t ret = real_read(fd, buf, count);
 
-    if (ret <= 0 || fd != g_pen_fd || !g_active || g_config.algorithm == ALG_OFF)
+    if (ret <= 0 || fd != g_pen_fd || !g_active)
+        return ret;
+    if (g_config.algorithm == ALG_OFF && !plugin_ready()
+        && !g_plugin_pending.load(std::memory_order_relaxed))
         return ret;
 
+    // evdev only returns whole events, but a pipe or file opened under the
+    // pen path can split them. Pass buffers through until the stream is
+    // back on an event boundary; a trailing partial event is left alone.
     size_t ev_size = sizeof(struct input_event);
+    size_t skew = g_stream_skew;
+    g_stream_skew = (skew + ret) % ev_size;
+    if (skew != 0) return ret;
+
+    struct rusage ru_before;
+    bool count_faults = g_config.fault_stats;
+    if (count_faults) getrusage(RUSAGE_THREAD, &ru_before);
+    bool left_proximity = false;
+
     size_t num_events = ret / ev_size;
     struct input_event* events = (struct input_event*)buf;
 
+    // Index of the first event of the frame being accumulated. A buffer
+    // can hold several frames; write-back must stay within the current one.
+    size_t frame_start = 0;
+
     // First pass: accumulate raw values
     for (size_t i = 0; i < num_events; i++) {
         struct input_event& ev = events[i];
@@ -465,50 +1594,49 @@ extern "C" ssize_t read(int fd, void* buf, size_t count) {
                 double rp = g_state.raw_pressure;
                 double ts = ev.time.tv_sec + ev.time.tv_usec / 1e6;
 
-                // Push raw point into history
-                history_push(rx, ry, rp,
-                            g_state.raw_tilt_x, g_state.raw_tilt_y);
-
-                // Apply filter
-                double fx, fy, fp;
-                apply_filter(rx, ry, rp, ts, fx, fy, fp);
-
-                // Debug: log every 50th event to show filtering is working
-                static int debug_counter = 0;
-                if (debug_counter++ % 50 == 0) {
-                    fprintf(stderr, "[stab] raw=(%d,%d) filtered=(%.0f,%.0f) delta=(%.1f,%.1f)\n",
-                            g_state.raw_x, g_state.raw_y, fx, fy,
-                            fx - rx, fy - ry);
-                }
-
-                // Write filtered values back into event buffer
-                for (size_t j = 0; j <= i; j++) {
-                    size_t k = i - j;
-                    if (events[k].type == EV_ABS) {
-                        if (events[k].code == ABS_X)
-                            events[k].value = (int)(fx + 0.5);
-                        else if (events[k].code == ABS_Y)
-                            events[k].value = (int)(fy + 0.5);
-                        else if (events[k].code == ABS_PRESSURE
-                                 && g_config.pressure_smoothing)
-                            events[k].value = (int)(fp + 0.5);
-                    }
+                // A plugin filters in batches, written back on flush
+                if (plugin_ready()) {
+                    plugin_enqueue(rx, ry, rp, g_state.raw_tilt_x, g_state.raw_tilt_y,
+                                   ts, frame_start, i);
+                    if (g_batch_count == PLUGIN_BATCH) flush_plugin_batch(events);
+                } else {
+                    // Push raw point into history
+                    history_push(rx, ry, rp,
+                                g_state.raw_tilt_x, g_state.raw_tilt_y, ts);
+                    filter_frame(events, frame_start, i, rx, ry, rp, ts);
                 }
             }
             g_state.has_x = false;
             g_state.has_y = false;
+            frame_start = i + 1;
         }
 
         // Pen lift detection: RMPP has no BTN_TOUCH
         // Reset on pressure < threshold or BTN_TOOL_PEN release
         if (ev.type == EV_ABS && ev.code == ABS_PRESSURE
-            && ev.value < 50) {
+            && ev.value < PEN_DOWN_PRESSURE) {
+            stroke_boundary(events);
             history_clear();
         }
         if (ev.type == EV_KEY && ev.code == BTN_TOOL_PEN
             && ev.value == 0) {
+            stroke_boundary(events);
             history_clear();
+            left_proximity = true;
         }
+        // Hover-enter: switch engines and warm the state before the pen lands
+        if (ev.type == EV_KEY && ev.code == BTN_TOOL_PEN && ev.value == 1) {
+            stroke_boundary(events);
+            if (g_config.lock_memory) prefault_hot_state();
+        }
+    }
+    flush_plugin_batch(events);
+
+    if (count_faults) {
+        struct rusage ru_after;
+        getrusage(RUSAGE_THREAD, &ru_after);
+        account_faults(ru_before, ru_after);
+        if (left_proximity) report_faults();
     }
 
     return ret;
@@ -0,0 +1,77 @@
+/*
+ * rmpp-stabilizer — Filter plugin ABI
+ *
+ * A plugin is a shared object exporting STABILIZER_PLUGIN_ENTRY, which
+ * returns a static stabilizer_plugin table. libstabilizer.so loads
+ * <plugin_dir>/<plugin>.so when the config names one, and switches to it
+ * at the next stroke boundary without restarting xochitl. The built-in
+ * `algorithm` stays as the fallback: a plugin that faults, returns an
+ * error or overruns its time budget is dropped until the config
+ * changes.
+ *
+ * Threading: init, params and destroy run on the library's loader
+ * thread, or for the first plugin of a session inside xochitl's open()
+ * of the pen; process and reset run on xochitl's input thread. They
+ * are never called concurrently on one instance.
+ *
+ * Plain C so plugins can be built with any toolchain.
+ *
+ * MIT License
+ */
+
+#ifndef STABILIZER_PLUGIN_H
+#define STABILIZER_PLUGIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped on any incompatible change; new trailing fields bump nothing
+ * and are detected through stabilizer_plugin.size. */
+#define STABILIZER_PLUGIN_ABI 1
+#define STABILIZER_PLUGIN_ENTRY "stabilizer_plugin_v1"
+
+/* One frame with a position. Raw values in, filtered values out, in
+ * place. Hover frames (pressure below 50) are passed too, as the
+ * built-in filters see them; return them unchanged to leave hover
+ * alone. */
+typedef struct stabilizer_point {
+    double x, y;        /* digitizer units */
+    double pressure;    /* written back only with pressure_smoothing=true */
+    double t;           /* event timestamp, seconds */
+} stabilizer_point;
+
+typedef struct stabilizer_plugin {
+    uint32_t abi_version;   /* STABILIZER_PLUGIN_ABI */
+    uint32_t size;          /* sizeof(stabilizer_plugin) */
+    const char* name;
+
+    /* New instance, or NULL on failure */
+    void* (*init)(void);
+    /* Called once per config line (key, value) after init, including
+     * strength. Return 0 for keys the plugin doesn't know; anything
+     * else rejects the value and the plugin is not loaded. */
+    int (*params)(void* self, const char* key, const char* value);
+    /* Filters in place n consecutive frames from between two stroke
+     * boundaries (hover-enter, pen lift, leaving proximity). Returns 0
+     * on success; anything else drops the plugin until the config
+     * changes. */
+    int (*process)(void* self, stabilizer_point* points, size_t n);
+    /* Pen lifted or left proximity: forget the stroke */
+    void (*reset)(void* self);
+    void (*destroy)(void* self);
+} stabilizer_plugin;
+
+typedef const stabilizer_plugin* (*stabilizer_plugin_entry_fn)(void);
+
+/* The entry point each plugin defines, named by STABILIZER_PLUGIN_ENTRY */
+const stabilizer_plugin* stabilizer_plugin_v1(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STABILIZER_PLUGIN_H */
@@ -0,0 +1,430 @@
+/*
+ * pen_fuzz — Worst-case-oriented fuzz target for the read() hook
+ *
+ * Each input is played through libstabilizer.so in-process:
+ *
+ *   byte 0      config: algorithm (low 3 bits), pressure_smoothing (bit 3)
+ *   bytes 1-4   seed for the read() size sequence
+ *   rest        raw bytes served from the pen device
+ *
+ * Read sizes mix whole-event counts (up to a few hundred frames),
+ * arbitrary byte counts, so events and frames straddle read()s, and
+ * single reads of everything left (thousands of events). Beyond
+ * crashes and sanitizer reports, an input fails when:
+ *
+ *   - time per event exceeds --max-ns-per-event (best of 3 runs), which
+ *     catches quadratic scans and pathological slow paths
+ *   - a rewritten ABS_X/ABS_Y/ABS_PRESSURE value falls outside the range
+ *     of raw values fed in; every filter is a convex combination of its
+ *     inputs, so escaping it means a filter diverged (bezier may
+ *     overshoot, so x/y get a margin of four times the raw spread)
+ *   - anything other than those values is modified
+ *   - a filter produced NaN/inf, which the library passes through as the
+ *     raw value; the fuzz build (-DSTABILIZER_CHECK_FINITE) counts these
+ *     in stabilizer_nonfinite_outputs, checked after every read()
+ *
+ * Built two ways (see Makefile):
+ *   make fuzz                  standalone: structured generator (odd event
+ *                              orderings, out-of-range values, bursts of
+ *                              thousands of events) under ASan/UBSan
+ *   make fuzz LIBFUZZER=1      clang libFuzzer target over the raw format
+ *
+ * Standalone usage: pen_fuzz [--lib PATH] [--iterations N] [--seed S]
+ *                            [--max-ns-per-event N] [input ...]
+ * Failing inputs are written to pen-fuzz-<kind>.bin and the run aborts;
+ * pass the file back as an input to reproduce.
+ *
+ * MIT License
+ */
+
+#include "pen_recording.h"
+
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__SANITIZE_ADDRESS__)
+#define PEN_FUZZ_SANITIZED 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define PEN_FUZZ_SANITIZED 1
+#endif
+#endif
+#ifdef PEN_FUZZ_SANITIZED
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+static const char* FUZZ_ALGORITHMS[] = {
+    "off", "moving_avg", "gaussian", "string_pull", "one_euro", "bezier"
+};
+static const int NUM_ALGORITHMS = 6;
+static const size_t HEADER_SIZE = 5;
+static const size_t MAX_READ_BYTES = 256 * 1024;   // ~10k events in one read()
+static const size_t MIN_TIMED_EVENTS = 256;
+
+struct FuzzContext {
+    StabilizerLib lib;
+    ScratchDevice scratch;
+    std::string configs[NUM_ALGORITHMS * 2];
+    std::vector<input_event> buf;
+    double max_ns_per_event = 2000;
+    const unsigned long* nonfinite = nullptr;   // debug builds of the library only
+    bool ready = false;
+};
+
+static FuzzContext g_fuzz;
+
+static bool fuzz_setup(const char* lib_path) {
+    FuzzContext& c = g_fuzz;
+    if (!load_stabilizer(lib_path, c.lib)) return false;
+    c.nonfinite = (const unsigned long*)dlsym(c.lib.handle, "stabilizer_nonfinite_outputs");
+    if (!c.nonfinite)
+        fprintf(stderr, "pen_fuzz: %s built without STABILIZER_CHECK_FINITE, "
+                "NaN outputs go undetected\n", lib_path);
+
+    if (!scratch_create(c.scratch, "pen_fuzz")) return false;
+    for (int i = 0; i < NUM_ALGORITHMS * 2; i++) {
+        c.configs[i] = c.scratch.dir + "/stabilizer" + std::to_string(i) + ".conf";
+        write_config(c.configs[i].c_str(), FUZZ_ALGORITHMS[i % NUM_ALGORITHMS], 0.5);
+        if (FILE* f = fopen(c.configs[i].c_str(), "a")) {
+            fprintf(f, "pressure_smoothing=%s\n", i >= NUM_ALGORITHMS ? "true" : "false");
+            fclose(f);
+        }
+    }
+    c.buf.resize(MAX_READ_BYTES / sizeof(input_event) + 1);
+
+    // The library's config and debug logging would drown the report;
+    // sanitizer reports keep going to the original stderr
+    int saved_err = redirect_stderr();
+#ifdef PEN_FUZZ_SANITIZED
+    __sanitizer_set_report_fd((void*)(intptr_t)saved_err);
+#else
+    close(saved_err);
+#endif
+    c.ready = true;
+    return true;
+}
+
+static void fuzz_teardown() {
+    scratch_remove(g_fuzz.scratch);
+}
+
+static void fail(const char* kind, const uint8_t* data, size_t size, const char* detail) {
+    std::string path = std::string("pen-fuzz-") + kind + ".bin";
+    if (FILE* f = fopen(path.c_str(), "wb")) {
+        fwrite(data, 1, size, f);
+        fclose(f);
+    }
+    printf("pen_fuzz: %s: %s (input saved to %s)\n", kind, detail, path.c_str());
+    fflush(stdout);
+    abort();
+}
+
+// Resets the library between inputs: a frame at the origin, then the
+// pen leaving proximity, so no stroke state carries over.
+static void reset_events(std::vector<input_event>& out) {
+    const uint16_t seq[][2] = {
+        { EV_ABS, ABS_X }, { EV_ABS, ABS_Y }, { EV_ABS, ABS_PRESSURE },
+        { EV_SYN, SYN_REPORT }, { EV_KEY, BTN_TOOL_PEN }, { EV_SYN, SYN_REPORT }
+    };
+    for (const auto& s : seq) {
+        input_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.type = s[0]; ev.code = s[1];
+        out.push_back(ev);
+    }
+}
+
+struct Bounds {
+    int64_t lo[3], hi[3];   // x, y, pressure
+};
+
+static int axis_of(const input_event& ev) {
+    if (ev.type != EV_ABS) return -1;
+    if (ev.code == ABS_X) return 0;
+    if (ev.code == ABS_Y) return 1;
+    if (ev.code == ABS_PRESSURE) return 2;
+    return -1;
+}
+
+// Plays the input once; returns hook time in ns and checks outputs.
+static uint64_t play(const uint8_t* data, size_t size, const std::vector<uint8_t>& stream,
+                     const Bounds& b, bool check) {
+    FuzzContext& c = g_fuzz;
+    int cfg = (data[0] & 7) % NUM_ALGORITHMS + ((data[0] & 8) ? NUM_ALGORITHMS : 0);
+    setenv("STABILIZER_CONFIG", c.configs[cfg].c_str(), 1);
+
+    // Curve fitting may overshoot the raw points, though not by more
+    // than a few times their spread
+    Bounds lim = b;
+    if (strcmp(FUZZ_ALGORITHMS[cfg % NUM_ALGORITHMS], "bezier") == 0) {
+        for (int a = 0; a < 2; a++) {
+            int64_t margin = 4 * (b.hi[a] - b.lo[a]);
+            lim.lo[a] -= margin;
+            lim.hi[a] += margin;
+        }
+    }
+    uint32_t rng = (uint32_t)data[1] | (uint32_t)data[2] << 8
+                 | (uint32_t)data[3] << 16 | (uint32_t)data[4] << 24;
+
+    int fd = c.lib.open(c.scratch.device.c_str(), O_RDONLY);
+    if (fd < 0) fail("setup", data, size, "cannot open device file");
+
+    std::vector<input_event>& buf = c.buf;
+    size_t reset_bytes = 6 * sizeof(input_event);
+    size_t offset = 0;
+    uint64_t total = 0;
+    while (true) {
+        size_t want;
+        rng = rng * 1664525u + 1013904223u;
+        uint32_t kind = (rng >> 24) % 8;
+        if (offset == 0) {
+            want = reset_bytes;
+        } else if (kind < 5) {
+            // Mostly whole events, from one up to a burst of hundreds
+            want = (1 + (rng >> 8) % 340) * sizeof(input_event);
+        } else if (kind < 7) {
+            want = 1 + (rng >> 8) % 8192;
+        } else {
+            want = MAX_READ_BYTES;
+        }
+        if (want > MAX_READ_BYTES) want = MAX_READ_BYTES;
+
+        uint64_t t0 = mono_ns();
+        ssize_t n = c.lib.read(fd, buf.data(), want);
+        total += mono_ns() - t0;
+        if (n <= 0) break;
+        if (offset + n > stream.size()) fail("length", data, size, "read past end of stream");
+        if (c.nonfinite && *c.nonfinite != 0)
+            fail("nan", data, size, "a filter produced a non-finite output");
+
+        if (check) {
+            const uint8_t* in = &stream[offset];
+            const uint8_t* out = (const uint8_t*)buf.data();
+            // Compare event by event where the read is aligned with the stream
+            for (size_t i = 0; i < (size_t)n; ) {
+                size_t pos = offset + i;
+                size_t skew = pos % sizeof(input_event);
+                if (skew != 0 || i + sizeof(input_event) > (size_t)n) {
+                    if (in[i] != out[i]) fail("modified", data, size, "byte outside an event changed");
+                    i++;
+                    continue;
+                }
+                input_event ei, eo;
+                memcpy(&ei, in + i, sizeof(ei));
+                memcpy(&eo, out + i, sizeof(eo));
+                int axis = axis_of(ei);
+                if (axis < 0 || ei.type != eo.type || ei.code != eo.code) {
+                    if (memcmp(&ei, &eo, sizeof(ei)) != 0)
+                        fail("modified", data, size, "non-position event changed");
+                } else if (memcmp(&ei.time, &eo.time, sizeof(ei.time)) != 0) {
+                    fail("modified", data, size, "event timestamp changed");
+                } else if (eo.value < lim.lo[axis] || eo.value > lim.hi[axis]) {
+                    char msg[128];
+                    snprintf(msg, sizeof(msg), "axis %d output %d outside raw range [%lld, %lld]",
+                             axis, eo.value, (long long)lim.lo[axis], (long long)lim.hi[axis]);
+                    fail("range", data, size, msg);
+                }
+                i += sizeof(input_event);
+            }
+        }
+        offset += n;
+    }
+    close(fd);
+    if (offset != stream.size()) fail("length", data, size, "short stream");
+    return total;
+}
+
+static int fuzz_one(const uint8_t* data, size_t size) {
+    if (size < HEADER_SIZE || !g_fuzz.ready) return 0;
+
+    std::vector<input_event> reset;
+    reset_events(reset);
+    std::vector<uint8_t> stream((const uint8_t*)reset.data(),
+                                (const uint8_t*)(reset.data() + reset.size()));
+    stream.insert(stream.end(), data + HEADER_SIZE, data + size);
+
+    // Raw value range per axis, including the reset frame's zeros
+    Bounds b = { { 0, 0, 0 }, { 0, 0, 0 } };
+    for (size_t i = 0; i + sizeof(input_event) <= stream.size(); i += sizeof(input_event)) {
+        input_event ev;
+        memcpy(&ev, &stream[i], sizeof(ev));
+        int axis = axis_of(ev);
+        if (axis < 0) continue;
+        if (ev.value < b.lo[axis]) b.lo[axis] = ev.value;
+        if (ev.value > b.hi[axis]) b.hi[axis] = ev.value;
+    }
+
+    int fd = open(g_fuzz.scratch.device.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0 || write(fd, stream.data(), stream.size()) != (ssize_t)stream.size())
+        fail("setup", data, size, "cannot write device file");
+    close(fd);
+
+    uint64_t ns = play(data, size, stream, b, true);
+    size_t events = (size - HEADER_SIZE) / sizeof(input_event);
+    if (events >= MIN_TIMED_EVENTS && ns > g_fuzz.max_ns_per_event * events) {
+        // Confirm it isn't scheduling noise before flagging
+        for (int i = 0; i < 2 && ns > g_fuzz.max_ns_per_event * events; i++) {
+            uint64_t again = play(data, size, stream, b, false);
+            if (again < ns) ns = again;
+        }
+        if (ns > g_fuzz.max_ns_per_event * events) {
+            char msg[128];
+            snprintf(msg, sizeof(msg), "%.0f ns/event over %zu events",
+                     (double)ns / events, events);
+            fail("slow", data, size, msg);
+        }
+    }
+    return 0;
+}
+
+#ifdef PEN_FUZZ_LIBFUZZER
+
+extern "C" int LLVMFuzzerInitialize(int*, char***) {
+    const char* lib = getenv("PEN_FUZZ_LIB");
+    const char* limit = getenv("PEN_FUZZ_MAX_NS_PER_EVENT");
+    if (limit) g_fuzz.max_ns_per_event = atof(limit);
+    if (!fuzz_setup(lib ? lib : "build/fuzz/libstabilizer.so")) abort();
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    return fuzz_one(data, size);
+}
+
+#else
+
+// ============================================================
+// Standalone structured generator
+// ============================================================
+
+static uint32_t next(uint32_t& s) {
+    s = s * 1664525u + 1013904223u;
+    return s >> 8;
+}
+
+static int pick_value(uint32_t& s) {
+    switch (next(s) % 8) {
+        case 0: return INT_MIN;
+        case 1: return INT_MAX;
+        case 2: return -(int)(next(s) % 100000);
+        case 3: return 0;
+        case 4: return 1 + next(s) % 49;                // just under the lift threshold
+        default: return (int)(next(s) % 20000);         // roughly in range
+    }
+}
+
+static std::vector<uint8_t> generate(uint32_t& s) {
+    std::vector<uint8_t> out(HEADER_SIZE);
+    for (size_t i = 0; i < HEADER_SIZE; i++) out[i] = (uint8_t)next(s);
+
+    // Mostly short streams, sometimes bursts of thousands of events
+    size_t count = (next(s) % 4 == 0) ? 2000 + next(s) % 6000 : 1 + next(s) % 300;
+    static const uint16_t ABS_CODES[] = {
+        ABS_X, ABS_Y, ABS_PRESSURE, ABS_DISTANCE, ABS_TILT_X, ABS_TILT_Y, ABS_MT_SLOT
+    };
+    int64_t sec = 1000, usec = 0;
+    int style = next(s) % 3;   // 0: well-formed strokes, 1: chaotic, 2: position-only burst
+    for (size_t i = 0; i < count; i++) {
+        input_event ev;
+        memset(&ev, 0, sizeof(ev));
+        uint32_t r = next(s) % 100;
+        if (style == 2) {
+            ev.type = (i % 2) ? EV_SYN : EV_ABS;
+            ev.code = (i % 2) ? SYN_REPORT : ((i / 2) % 2 ? ABS_Y : ABS_X);
+            ev.value = (int)(next(s) % 20000);
+        } else if (r < 55) {
+            ev.type = EV_ABS;
+            ev.code = ABS_CODES[next(s) % 7];
+            ev.value = style == 0 ? (int)(next(s) % 20000) : pick_value(s);
+        } else if (r < 85) {
+            ev.type = EV_SYN;
+            ev.code = (next(s) % 10) ? SYN_REPORT : SYN_DROPPED;
+        } else if (r < 95) {
+            ev.type = EV_KEY;
+            ev.code = (next(s) % 4) ? BTN_TOOL_PEN : BTN_TOUCH;
+            ev.value = next(s) % 3;
+        } else {
+            ev.type = (uint16_t)next(s);
+            ev.code = (uint16_t)next(s);
+            ev.value = pick_value(s);
+        }
+
+        // Time mostly advances at ~500Hz-4kHz; chaos mode also repeats,
+        // rewinds and jumps it
+        if (style == 1 && next(s) % 10 == 0) {
+            switch (next(s) % 5) {
+                case 0: break;                                  // repeat
+                case 1: sec -= next(s) % 5; break;              // rewind
+                case 2: sec += next(s); break;                  // jump ahead
+                case 3: sec = (next(s) & 1) ? INT64_MAX / 2 : -INT64_MAX / 2; break;
+                default: usec = next(s) % 2000000; break;       // invalid usec
+            }
+        } else if (ev.type == EV_SYN) {
+            usec += 250 + next(s) % 1750;
+            if (usec >= 1000000) { sec++; usec -= 1000000; }
+        }
+        ev.time.tv_sec = (time_t)sec;
+        ev.time.tv_usec = (suseconds_t)usec;
+
+        const uint8_t* p = (const uint8_t*)&ev;
+        out.insert(out.end(), p, p + sizeof(ev));
+    }
+    // Sometimes leave a partial event at the end
+    if (next(s) % 4 == 0) out.resize(out.size() - 1 - next(s) % (sizeof(input_event) - 1));
+    return out;
+}
+
+int main(int argc, char** argv) {
+    std::string lib = "build/fuzz/libstabilizer.so";
+    long iterations = 10000;
+    uint32_t seed = 1;
+    std::vector<const char*> inputs;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : "";
+        if (a == "--lib") { lib = v; i++; }
+        else if (a == "--iterations") { iterations = atol(v); i++; }
+        else if (a == "--seed") { seed = (uint32_t)atol(v); i++; }
+        else if (a == "--max-ns-per-event") { g_fuzz.max_ns_per_event = atof(v); i++; }
+        else if (a[0] == '-') {
+            fprintf(stderr, "usage: %s [--lib PATH] [--iterations N] [--seed S] "
+                            "[--max-ns-per-event N] [input ...]\n", argv[0]);
+            return 2;
+        }
+        else inputs.push_back(argv[i]);
+    }
+    if (!fuzz_setup(lib.c_str())) return 1;
+
+    if (!inputs.empty()) {
+        for (const char* path : inputs) {
+            std::vector<uint8_t> data;
+            if (FILE* f = fopen(path, "rb")) {
+                int ch;
+                while ((ch = fgetc(f)) != EOF) data.push_back((uint8_t)ch);
+                fclose(f);
+            }
+            fuzz_one(data.data(), data.size());
+            printf("pen_fuzz: %s ok\n", path);
+        }
+        fuzz_teardown();
+        return 0;
+    }
+
+    uint64_t events = 0, start = mono_ns();
+    for (long i = 0; i < iterations; i++) {
+        std::vector<uint8_t> data = generate(seed);
+        fuzz_one(data.data(), data.size());
+        events += (data.size() - HEADER_SIZE) / sizeof(input_event);
+    }
+    printf("pen_fuzz: %ld inputs, %llu events, %.0f ns/event overall\n",
+           iterations, (unsigned long long)events,
+           events ? (double)(mono_ns() - start) / events : 0.0);
+    fuzz_teardown();
+    return 0;
+}
+
+#endif
@@ -0,0 +1,412 @@
+/*
+ * pen_harness — End-to-end playback harness for libstabilizer.so
+ *
+ * Creates a virtual pen with uinput (or a FIFO when /dev/uinput is not
+ * available), starts pen_reader with the library preloaded, and plays a
+ * recording into the device at its original timing. Afterwards it
+ * compares what the reader saw against a reference run of the same
+ * library fed one frame per read(), and reports device-to-reader
+ * latency.
+ *
+ * This exercises the real shared object: open() detection, multi-frame
+ * read() buffers, frames split across reads, and scheduling noise from
+ * a stalling reader.
+ *
+ * Usage: pen_harness [options] [recording.ev]
+ *   --lib PATH          library to test (default build/host/libstabilizer.so)
+ *   --reader PATH       reader binary (default: next to this binary)
+ *   --algorithm NAME    off | moving_avg | gaussian | string_pull | one_euro | bezier
+ *   --strength S        0.0-1.0 (default 0.5)
+ *   --set KEY=VALUE     extra config line, e.g. --set lock_memory=true
+ *   --transport T       auto | uinput | pipe (default auto)
+ *   --speed F           playback speed multiplier (default 1.0)
+ *   --rate HZ           synthetic report rate (default 500)
+ *   --strokes N         synthetic stroke count (default 3)
+ *   --keep              keep the scratch directory
+ *   Reader options --read-events, --random-reads, --stall-prob,
+ *   --stall-ms and --seed are passed through.
+ *
+ * Exits non-zero when frames are lost or a whole (non-split) frame
+ * differs from the reference.
+ *
+ * MIT License
+ */
+
+#include "pen_recording.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <linux/uinput.h>
+#include <signal.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+struct Options {
+    std::string lib = "build/host/libstabilizer.so";
+    std::string reader;
+    std::string algorithm = "string_pull";
+    double strength = 0.5;
+    std::string transport = "auto";
+    double speed = 1.0;
+    SynthParams synth;
+    std::vector<std::string> reader_args;
+    std::vector<std::string> config_lines;
+    const char* recording = nullptr;
+    bool keep = false;
+};
+
+// ============================================================
+// Transports
+// ============================================================
+
+static const int UINPUT_ABS_CODES[] = {
+    ABS_X, ABS_Y, ABS_PRESSURE, ABS_DISTANCE, ABS_TILT_X, ABS_TILT_Y
+};
+
+static int uinput_create(std::string& node) {
+    int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (fd < 0) return -1;
+
+    ioctl(fd, UI_SET_EVBIT, EV_KEY);
+    ioctl(fd, UI_SET_KEYBIT, BTN_TOOL_PEN);
+    ioctl(fd, UI_SET_KEYBIT, BTN_TOUCH);
+    ioctl(fd, UI_SET_KEYBIT, BTN_STYLUS);
+    ioctl(fd, UI_SET_EVBIT, EV_ABS);
+    ioctl(fd, UI_SET_PROPBIT, INPUT_PROP_DIRECT);
+    for (int code : UINPUT_ABS_CODES) {
+        uinput_abs_setup abs;
+        memset(&abs, 0, sizeof(abs));
+        abs.code = code;
+        abs.absinfo.minimum = (code == ABS_TILT_X || code == ABS_TILT_Y) ? -9000 : 0;
+        abs.absinfo.maximum = (code == ABS_PRESSURE) ? 4095 : 65535;
+        if (ioctl(fd, UI_ABS_SETUP, &abs) < 0) { close(fd); return -1; }
+    }
+
+    uinput_setup setup;
+    memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    snprintf(setup.name, sizeof(setup.name), "Elan marker input (harness)");
+    if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    // Map the uinput device to its /dev/input/eventN node
+    char sysname[64] = {0};
+    if (ioctl(fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) >= 0) {
+        std::string dir = std::string("/sys/devices/virtual/input/") + sysname;
+        if (DIR* d = opendir(dir.c_str())) {
+            while (dirent* e = readdir(d)) {
+                if (strncmp(e->d_name, "event", 5) == 0)
+                    node = std::string("/dev/input/") + e->d_name;
+            }
+            closedir(d);
+        }
+    }
+    // Give udev a moment to create the node
+    for (int i = 0; i < 100 && !node.empty() && access(node.c_str(), R_OK) != 0; i++)
+        usleep(10000);
+    if (node.empty() || access(node.c_str(), R_OK) != 0) {
+        ioctl(fd, UI_DEV_DESTROY);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// ============================================================
+// Reference run: same library, one frame per read()
+// ============================================================
+
+static bool reference_run(const Options& o, const ScratchDevice& scratch,
+                          const std::vector<input_event>& evs,
+                          const std::vector<PenFrame>& frames,
+                          std::vector<PenSample>& out) {
+    if (!scratch_write_events(scratch, evs)) return false;
+
+    StabilizerLib lib;
+    if (!load_stabilizer(o.lib.c_str(), lib)) return false;
+
+    // Keep the library's own logging out of the report
+    int saved_err = redirect_stderr((scratch.dir + "/reference.log").c_str());
+    int fd = lib.open(scratch.device.c_str(), O_RDONLY);
+    bool ok = fd >= 0 && play_frames(lib, fd, frames, &out);
+    if (fd >= 0) close(fd);
+    restore_stderr(saved_err);
+    // Deliberately not dlclose()d: its hooks hold no resources.
+    return ok;
+}
+
+// ============================================================
+// Reader process
+// ============================================================
+
+static pid_t spawn_reader(const Options& o, const std::string& device,
+                          const std::string& log, const ScratchDevice& scratch,
+                          long frames, int& ready_fd) {
+    int pipefd[2];
+    if (pipe(pipefd) < 0) return -1;
+
+    std::string lib_abs = o.lib;
+    char resolved[PATH_MAX];
+    if (realpath(o.lib.c_str(), resolved)) lib_abs = resolved;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(pipefd[1], 1);
+        close(pipefd[0]);
+        close(pipefd[1]);
+        int err = open((scratch.dir + "/reader.log").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (err >= 0) { dup2(err, 2); close(err); }
+
+        setenv("LD_PRELOAD", lib_abs.c_str(), 1);
+        setenv("STABILIZER_PEN_DEVICE", device.c_str(), 1);
+        setenv("STABILIZER_CONFIG", scratch.config.c_str(), 1);
+
+        std::vector<std::string> args = { o.reader, device, log };
+        if (frames > 0) { args.push_back("--frames"); args.push_back(std::to_string(frames)); }
+        args.insert(args.end(), o.reader_args.begin(), o.reader_args.end());
+        std::vector<char*> argv;
+        for (std::string& a : args) argv.push_back(&a[0]);
+        argv.push_back(nullptr);
+        execv(o.reader.c_str(), argv.data());
+        perror("[harness] exec reader");
+        _exit(127);
+    }
+    close(pipefd[1]);
+    ready_fd = pipefd[0];
+    return pid;
+}
+
+static bool wait_ready(int fd) {
+    char line[16] = {0};
+    ssize_t n = read(fd, line, sizeof(line) - 1);
+    close(fd);
+    return n > 0 && strncmp(line, "ready", 5) == 0;
+}
+
+// ============================================================
+// Report
+// ============================================================
+
+struct ReaderFrame {
+    uint64_t recv_ns = 0;
+    PenSample s;
+    bool split = false;
+};
+
+static std::vector<ReaderFrame> load_reader_log(const std::string& path) {
+    std::vector<ReaderFrame> out;
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return out;
+    long idx;
+    unsigned long long ns;
+    int x, y, p, split;
+    while (fscanf(f, "%ld %llu %d %d %d %d", &idx, &ns, &x, &y, &p, &split) == 6) {
+        ReaderFrame r;
+        r.recv_ns = ns;
+        r.s.x = x; r.s.y = y; r.s.pressure = p;
+        r.split = split != 0;
+        out.push_back(r);
+    }
+    fclose(f);
+    return out;
+}
+
+static double percentile(std::vector<double> v, double q) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t i = (size_t)(q * (v.size() - 1) + 0.5);
+    return v[i];
+}
+
+static bool same(const PenSample& a, const PenSample& b) {
+    return a.x == b.x && a.y == b.y && a.pressure == b.pressure;
+}
+
+// ============================================================
+// Main
+// ============================================================
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "usage: %s [options] [recording.ev]  (see source header)\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : "";
+        if (a == "--lib") { o.lib = v; i++; }
+        else if (a == "--reader") { o.reader = v; i++; }
+        else if (a == "--algorithm") { o.algorithm = v; i++; }
+        else if (a == "--strength") { o.strength = atof(v); i++; }
+        else if (a == "--set") { o.config_lines.push_back(v); i++; }
+        else if (a == "--transport") { o.transport = v; i++; }
+        else if (a == "--speed") { o.speed = atof(v); i++; }
+        else if (a == "--rate") { o.synth.rate_hz = atof(v); i++; }
+        else if (a == "--strokes") { o.synth.strokes = atoi(v); i++; }
+        else if (a == "--keep") o.keep = true;
+        else if (a == "--random-reads") o.reader_args.push_back(a);
+        else if (a == "--read-events" || a == "--stall-prob" || a == "--stall-ms"
+                 || a == "--seed") {
+            o.reader_args.push_back(a);
+            o.reader_args.push_back(v);
+            i++;
+        }
+        else if (a[0] != '-') o.recording = argv[i];
+        else { usage(argv[0]); return 2; }
+    }
+    if (o.reader.empty()) {
+        std::string self = argv[0];
+        o.reader = std::string(dirname(&self[0])) + "/pen_reader";
+    }
+    if (o.speed <= 0) o.speed = 1.0;
+
+    std::vector<input_event> raw;
+    if (o.recording) {
+        if (!load_recording(o.recording, raw)) {
+            fprintf(stderr, "[harness] cannot read %s\n", o.recording);
+            return 1;
+        }
+    } else {
+        raw = synthesize_strokes(o.synth);
+    }
+    std::vector<input_event> evs = normalize_like_input_core(raw);
+    std::vector<PenFrame> frames = split_frames(evs);
+    if (frames.empty()) {
+        fprintf(stderr, "[harness] recording has no complete frames\n");
+        return 1;
+    }
+
+    ScratchDevice scratch;
+    if (!scratch_create(scratch, "pen_harness")) {
+        perror("[harness] mkdtemp");
+        return 1;
+    }
+    const char* conf = scratch.config.c_str();
+    if (!write_config(conf, o.algorithm.c_str(), o.strength)) return 1;
+    if (FILE* c = fopen(conf, "a")) {
+        for (const std::string& line : o.config_lines) fprintf(c, "%s\n", line.c_str());
+        fclose(c);
+    }
+
+    std::vector<PenSample> reference;
+    if (!reference_run(o, scratch, evs, frames, reference)) {
+        fprintf(stderr, "[harness] reference run failed\n");
+        return 1;
+    }
+
+    // Set up the device
+    std::string transport = o.transport, device;
+    int dev_fd = -1;
+    if (transport == "auto" || transport == "uinput") {
+        dev_fd = uinput_create(device);
+        if (dev_fd >= 0) transport = "uinput";
+        else if (transport == "uinput") {
+            fprintf(stderr, "[harness] uinput unavailable: %s\n", strerror(errno));
+            return 1;
+        }
+    }
+    if (dev_fd < 0) {
+        transport = "pipe";
+        device = scratch.dir + "/pen.fifo";
+        if (mkfifo(device.c_str(), 0600) < 0) {
+            perror("[harness] mkfifo");
+            return 1;
+        }
+    }
+
+    std::string log = scratch.dir + "/reader.frames";
+    int ready_fd = -1;
+    pid_t reader = spawn_reader(o, device, log, scratch,
+                                transport == "uinput" ? (long)frames.size() : -1,
+                                ready_fd);
+    if (reader < 0 || !wait_ready(ready_fd)) {
+        fprintf(stderr, "[harness] reader failed to start (see %s/reader.log)\n",
+                scratch.dir.c_str());
+        return 1;
+    }
+    if (transport == "pipe") {
+        dev_fd = open(device.c_str(), O_WRONLY);
+        if (dev_fd < 0) {
+            perror("[harness] open fifo");
+            kill(reader, SIGTERM);
+            return 1;
+        }
+    }
+
+    // Play back at original timing
+    std::vector<uint64_t> sent_ns(frames.size());
+    uint64_t start = mono_ns();
+    double t0 = frames[0].t;
+    for (size_t i = 0; i < frames.size(); i++) {
+        const PenFrame& fr = frames[i];
+        uint64_t due = start + (uint64_t)((fr.t - t0) / o.speed * 1e9);
+        timespec ts = { (time_t)(due / 1000000000ull), (long)(due % 1000000000ull) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+
+        sent_ns[i] = mono_ns();
+        size_t bytes = (fr.end - fr.begin) * sizeof(input_event);
+        if (write(dev_fd, &evs[fr.begin], bytes) != (ssize_t)bytes) {
+            perror("[harness] write");
+            break;
+        }
+    }
+    if (transport == "pipe") close(dev_fd);
+
+    int status = 0;
+    waitpid(reader, &status, 0);
+    if (transport == "uinput") {
+        ioctl(dev_fd, UI_DEV_DESTROY);
+        close(dev_fd);
+    }
+
+    // Compare
+    std::vector<ReaderFrame> got = load_reader_log(log);
+    std::vector<double> lat_us;
+    size_t mismatches = 0, split = 0, split_mismatches = 0, filtered = 0;
+    PenSample raw_state;
+    for (size_t i = 0; i < got.size() && i < frames.size(); i++) {
+        apply_frame(raw_state, &evs[frames[i].begin], frames[i].end - frames[i].begin);
+        if (!same(raw_state, reference[i])) filtered++;
+        lat_us.push_back((double)(got[i].recv_ns - sent_ns[i]) / 1000.0);
+        if (got[i].split) {
+            split++;
+            if (!same(got[i].s, reference[i])) split_mismatches++;
+        } else if (!same(got[i].s, reference[i])) {
+            if (mismatches < 5)
+                fprintf(stderr, "[harness] frame %zu: reader (%d,%d,%d) reference (%d,%d,%d)\n",
+                        i, got[i].s.x, got[i].s.y, got[i].s.pressure,
+                        reference[i].x, reference[i].y, reference[i].pressure);
+            mismatches++;
+        }
+    }
+
+    printf("transport:   %s (%s)\n", transport.c_str(), device.c_str());
+    printf("algorithm:   %s strength=%.2f\n", o.algorithm.c_str(), o.strength);
+    printf("frames:      sent=%zu received=%zu filtered=%zu\n",
+           frames.size(), got.size(), filtered);
+    printf("split reads: %zu frames (%zu differ from reference)\n", split, split_mismatches);
+    printf("mismatches:  %zu whole frames\n", mismatches);
+    printf("latency us:  p50=%.0f p95=%.0f p99=%.0f max=%.0f\n",
+           percentile(lat_us, 0.50), percentile(lat_us, 0.95),
+           percentile(lat_us, 0.99), percentile(lat_us, 1.0));
+
+    bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0
+              && got.size() == frames.size() && mismatches == 0;
+    if (o.keep || !ok) {
+        printf("scratch:     %s\n", scratch.dir.c_str());
+    } else {
+        scratch_remove(scratch);
+    }
+    return ok ? 0 : 1;
+}
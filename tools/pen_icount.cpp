@@ -0,0 +1,68 @@
+/*
+ * pen_icount — Instruction-count driver for the aarch64 build
+ *
+ * Cross-compiled alongside libstabilizer.so and run under qemu-aarch64
+ * with an instruction-counting plugin by scripts/icount_bench.sh. Loads
+ * the library in-process, configures one algorithm and feeds the
+ * corpus through the read() hook one frame per call, as xochitl does at
+ * 500Hz. Prints the number of frames fed on stdout.
+ *
+ * With algorithm=off the hook returns before its event loop, so the
+ * script's algorithm=off run covers only dlopen, config parsing and the
+ * read syscalls. Subtracting it and dividing by the frame count gives
+ * what the hook adds per frame: event parsing, the filter and the
+ * write-back, not the filter alone.
+ *
+ * Usage: pen_icount <libstabilizer.so> <algorithm> [recording.ev ...]
+ *
+ * MIT License
+ */
+
+#include "pen_recording.h"
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <libstabilizer.so> <algorithm> [recording.ev ...]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<input_event> raw;
+    for (int i = 3; i < argc; i++) {
+        if (!load_recording(argv[i], raw)) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (argc == 3) {
+        // Fixed synthetic corpus so counts are comparable across commits
+        SynthParams sp;
+        sp.strokes = 8;
+        raw = synthesize_strokes(sp);
+    }
+    std::vector<input_event> evs = normalize_like_input_core(raw);
+    std::vector<PenFrame> frames = split_frames(evs);
+
+    ScratchDevice scratch;
+    if (!scratch_create(scratch, "pen_icount")) return 1;
+    if (!scratch_write_events(scratch, evs)) return 1;
+    write_config(scratch.config.c_str(), argv[2], 0.5);
+
+    StabilizerLib lib;
+    if (!load_stabilizer(argv[1], lib)) return 1;
+
+    int fd = lib.open(scratch.device.c_str(), O_RDONLY);
+    if (fd < 0) return 1;
+    bool ok = play_frames(lib, fd, frames);
+    close(fd);
+    scratch_remove(scratch);
+
+    size_t fed = ok ? frames.size() : 0;
+    printf("%zu\n", fed);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,345 @@
+/*
+ * pen_plugin_check — Hot-swap and fallback check for filter plugins
+ *
+ * Loads libstabilizer.so in-process with pen_test_plugin.so in the
+ * plugin directory and plays synthetic strokes through the read() hook,
+ * several frames per read so plugin batches straddle reads:
+ *
+ *   builtin   moving_avg alone, the reference output
+ *   live      a session opened without a plugin picks up plugin= added
+ *             mid-session, without re-opening the device
+ *   offset    the plugin filters every pen-down frame
+ *   swap      the config is rewritten mid-session; the loader picks the
+ *             new plugin up and the hook switches at a stroke boundary,
+ *             so no stroke mixes instances and the last uses the new one
+ *   segv, error, nan
+ *             the plugin is dropped on its first batch and the whole
+ *             session matches the built-in reference
+ *   chain     faults outside any plugin reach the host's own SIGSEGV
+ *             handler each time, and the plugin guard stays installed
+ *   late      the plugin fails on a pen-down batch partway through the
+ *             first stroke; every axis event from that batch on matches
+ *             a built-in run, so the fallback took over with the
+ *             history and filter state it would have had. Run for
+ *             moving_avg and for the stateful string_pull, one_euro
+ *             and bezier
+ *   reject    params() rejects a config line, so the plugin is never
+ *             loaded and the session matches the reference
+ *   slow      the plugin overruns its budget and is dropped; the final
+ *             stroke matches the reference
+ *   unload    removing plugin= from the config returns to the built-in
+ *
+ * Each config change waits for the loader thread to pick it up.
+ *
+ * Usage: pen_plugin_check [--lib PATH] [--plugin-dir DIR] [--verbose]
+ *
+ * MIT License
+ */
+
+#include "pen_recording.h"
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static const int LOADER_WAIT_MS = 1200;   // over two PLUGIN_POLL_MS periods
+static const size_t FRAMES_PER_READ = 8;
+
+struct Corpus {
+    std::vector<input_event> evs;
+    std::vector<PenFrame> frames;
+    std::vector<PenSample> raw;     // per frame
+    std::vector<int> stroke;        // per frame, -1 while not pressed
+    int strokes = 0;
+};
+
+struct CheckContext {
+    StabilizerLib lib;
+    ScratchDevice scratch;
+    std::string plugin_dir;
+    Corpus corpus;
+};
+
+static void write_plugin_config(const CheckContext& c, const char* plugin, const char* extra,
+                                const char* algorithm = "moving_avg") {
+    write_config(c.scratch.config.c_str(), algorithm, 0.5);
+    if (!plugin) return;
+    if (FILE* f = fopen(c.scratch.config.c_str(), "a")) {
+        fprintf(f, "plugin=%s\nplugin_dir=%s\n%s", plugin, c.plugin_dir.c_str(), extra);
+        fclose(f);
+    }
+}
+
+static void wait_for_loader() {
+    usleep(LOADER_WAIT_MS * 1000);
+}
+
+// Plays the corpus in one session; on_stroke_end runs after the last
+// frame of the first stroke.
+static std::vector<PenSample> play(const CheckContext& c, void (*on_stroke_end)(const CheckContext&)) {
+    const Corpus& k = c.corpus;
+    std::vector<PenSample> out(k.frames.size());
+    int fd = c.lib.open(c.scratch.device.c_str(), O_RDONLY);
+    if (fd < 0) return out;
+
+    size_t split = 0;
+    if (on_stroke_end) {
+        while (split < k.frames.size() && !(k.stroke[split] == 0
+               && (split + 1 == k.frames.size() || k.stroke[split + 1] != 0)))
+            split++;
+        split++;
+    }
+    if (play_frames(c.lib, fd, k.frames, &out, 0, split, FRAMES_PER_READ)) {
+        if (on_stroke_end) on_stroke_end(c);
+        play_frames(c.lib, fd, k.frames, &out, split, SIZE_MAX, FRAMES_PER_READ);
+    }
+    close(fd);
+    return out;
+}
+
+static bool same(const PenSample& a, const PenSample& b) {
+    return a.x == b.x && a.y == b.y;
+}
+
+// Pen-down frames of strokes [first, last] that differ from want
+static int count_diffs(const Corpus& k, const std::vector<PenSample>& got,
+                       const std::vector<PenSample>& want, int first, int last) {
+    int diffs = 0;
+    for (size_t i = 0; i < k.frames.size(); i++)
+        if (k.stroke[i] >= first && k.stroke[i] <= last && !same(got[i], want[i])) diffs++;
+    return diffs;
+}
+
+// The x offset every pen-down frame of a stroke carries, or a sentinel
+// when the stroke mixes offsets
+static long stroke_offset(const Corpus& k, const std::vector<PenSample>& got, int stroke) {
+    const long MIXED = -999999;
+    long off = 0;
+    bool seen = false;
+    for (size_t i = 0; i < k.frames.size(); i++) {
+        if (k.stroke[i] != stroke) continue;
+        if (got[i].y != k.raw[i].y) return MIXED;
+        long d = (long)got[i].x - k.raw[i].x;
+        if (seen && d != off) return MIXED;
+        off = d;
+        seen = true;
+    }
+    return off;
+}
+
+// Whether frame i has an event for the axis. The reader keeps the last
+// written value of an axis a frame omits, whichever filter wrote it.
+static bool carries(const Corpus& k, size_t i, int code) {
+    for (size_t e = k.frames[i].begin; e < k.frames[i].end; e++)
+        if (k.evs[e].type == EV_ABS && k.evs[e].code == code) return true;
+    return false;
+}
+
+// First pen-down frame of stroke 0 that does not carry the plugin's
+// offset, i.e. the first frame the built-in filter took over
+static size_t takeover_frame(const Corpus& k, const std::vector<PenSample>& got) {
+    for (size_t i = 0; i < k.frames.size(); i++)
+        if (k.stroke[i] == 0 && (long)got[i].x - k.raw[i].x != 1000) return i;
+    return k.frames.size();
+}
+
+// The host's own SIGSEGV handler, installed before the library
+static sigjmp_buf g_host_env;
+static volatile sig_atomic_t g_host_armed = 0, g_host_faults = 0;
+
+// A plugin fault that reaches it means the guard was lost
+static void host_fault_handler(int) {
+    if (!g_host_armed) {
+        fflush(stdout);
+        static const char msg[] = "plugin fault reached the host handler\n";
+        write(STDOUT_FILENO, msg, sizeof(msg) - 1);
+        _exit(1);
+    }
+    g_host_armed = 0;
+    g_host_faults++;
+    siglongjmp(g_host_env, 1);
+}
+
+static void install_host_handler() {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = host_fault_handler;
+    sa.sa_flags = SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGSEGV, &sa, nullptr);
+}
+
+// Faults outside any plugin; the host handler jumps back here
+static void host_fault() {
+    if (sigsetjmp(g_host_env, 0) == 0) {
+        g_host_armed = 1;
+        *(volatile int*)nullptr = 1;
+    }
+}
+
+static void add_plugin(const CheckContext& c) {
+    write_plugin_config(c, "pen_test_plugin", "test_mode=offset\n");
+    wait_for_loader();
+}
+
+static void swap_to_negative(const CheckContext& c) {
+    write_plugin_config(c, "pen_test_plugin", "test_mode=offset\ntest_offset=-1000\n");
+    wait_for_loader();
+}
+
+static int report(const char* name, bool ok, const char* detail) {
+    printf("%-8s %s  %s\n", name, ok ? "ok  " : "FAIL", detail);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    std::string lib_path = "build/host/libstabilizer.so";
+    std::string plugin_dir = "build/host/plugins";
+    bool verbose = false;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : "";
+        if (a == "--lib") { lib_path = v; i++; }
+        else if (a == "--plugin-dir") { plugin_dir = v; i++; }
+        else if (a == "--verbose") verbose = true;
+        else {
+            fprintf(stderr, "usage: %s [--lib PATH] [--plugin-dir DIR] [--verbose]\n", argv[0]);
+            return 2;
+        }
+    }
+    char resolved[4096];
+    if (!realpath(plugin_dir.c_str(), resolved)) {
+        fprintf(stderr, "no plugin directory %s\n", plugin_dir.c_str());
+        return 1;
+    }
+
+    CheckContext c;
+    c.plugin_dir = resolved;
+    Corpus& k = c.corpus;
+    SynthParams sp;
+    sp.strokes = 4;
+    k.evs = normalize_like_input_core(synthesize_strokes(sp));
+    k.frames = split_frames(k.evs);
+    PenSample cur;
+    bool down = false;
+    for (const PenFrame& fr : k.frames) {
+        apply_frame(cur, &k.evs[fr.begin], fr.end - fr.begin);
+        k.raw.push_back(cur);
+        bool pressed = cur.pressure >= 50;
+        if (pressed && !down) k.strokes++;
+        down = pressed;
+        k.stroke.push_back(pressed ? k.strokes - 1 : -1);
+    }
+
+    if (!scratch_create(c.scratch, "pen_plugin_check")) return 1;
+    if (!scratch_write_events(c.scratch, k.evs)) return 1;
+    install_host_handler();
+    if (!load_stabilizer(lib_path.c_str(), c.lib)) return 1;
+
+    int saved_err = verbose ? -1 : redirect_stderr();
+
+    int failures = 0;
+    char detail[128];
+    int last = k.strokes - 1;
+
+    write_plugin_config(c, nullptr, "");
+    std::vector<PenSample> ref = play(c, nullptr);
+    int filtered = 0;
+    for (size_t i = 0; i < ref.size(); i++) if (k.stroke[i] >= 0 && !same(ref[i], k.raw[i])) filtered++;
+    snprintf(detail, sizeof(detail), "%d strokes, %d pen-down frames smoothed", k.strokes, filtered);
+    failures += report("builtin", filtered > 0, detail);
+
+    std::vector<PenSample> out = play(c, add_plugin);
+    bool ok = count_diffs(k, out, ref, 0, 0) == 0 && stroke_offset(k, out, last) == 1000;
+    snprintf(detail, sizeof(detail), "first stroke built-in, last stroke %+ld",
+             stroke_offset(k, out, last));
+    failures += report("live", ok, detail);
+
+    write_plugin_config(c, "pen_test_plugin", "test_mode=offset\n");
+    wait_for_loader();
+    out = play(c, nullptr);
+    ok = true;
+    for (int s = 0; s <= last; s++) ok = ok && stroke_offset(k, out, s) == 1000;
+    failures += report("offset", ok, "every stroke shifted by the plugin");
+
+    host_fault();
+    host_fault();
+    struct sigaction now;
+    sigaction(SIGSEGV, nullptr, &now);
+    bool guarded = (now.sa_flags & SA_SIGINFO) && now.sa_handler != host_fault_handler;
+    snprintf(detail, sizeof(detail), "host handler ran %d of 2 times, guard %s",
+             (int)g_host_faults, guarded ? "installed" : "gone");
+    failures += report("chain", g_host_faults == 2 && guarded, detail);
+
+    out = play(c, swap_to_negative);
+    ok = stroke_offset(k, out, 0) == 1000 && stroke_offset(k, out, last) == -1000;
+    for (int s = 1; s < last; s++) {
+        long off = stroke_offset(k, out, s);
+        ok = ok && (off == 1000 || off == -1000);
+    }
+    snprintf(detail, sizeof(detail), "first stroke %+ld, last stroke %+ld",
+             stroke_offset(k, out, 0), stroke_offset(k, out, last));
+    failures += report("swap", ok, detail);
+
+    const char* faults[] = { "segv", "error", "nan" };
+    for (const char* mode : faults) {
+        std::string extra = std::string("test_mode=") + mode + "\n";
+        write_plugin_config(c, "pen_test_plugin", extra.c_str());
+        wait_for_loader();
+        out = play(c, nullptr);
+        int diffs = count_diffs(k, out, ref, 0, last);
+        snprintf(detail, sizeof(detail), "%d frames differ from built-in", diffs);
+        failures += report(mode, diffs == 0, detail);
+    }
+
+    const char* late_algorithms[] = { "moving_avg", "string_pull", "one_euro", "bezier" };
+    for (const char* alg : late_algorithms) {
+        std::vector<PenSample> alg_ref = ref;
+        if (strcmp(alg, "moving_avg") != 0) {
+            write_plugin_config(c, nullptr, "", alg);
+            wait_for_loader();
+            alg_ref = play(c, nullptr);
+        }
+        write_plugin_config(c, "pen_test_plugin", "test_mode=late\n", alg);
+        wait_for_loader();
+        out = play(c, nullptr);
+        size_t from = takeover_frame(k, out);
+        int late_diffs = 0;
+        for (size_t i = from; i < k.frames.size(); i++)
+            if ((carries(k, i, ABS_X) && out[i].x != alg_ref[i].x)
+                || (carries(k, i, ABS_Y) && out[i].y != alg_ref[i].y)) late_diffs++;
+        ok = from > 0 && from < k.frames.size() && k.stroke[from - 1] == 0 && late_diffs == 0;
+        snprintf(detail, sizeof(detail), "%s dropped at frame %zu, %d frames after differ from built-in",
+                 alg, from, late_diffs);
+        failures += report("late", ok, detail);
+    }
+
+    write_plugin_config(c, "pen_test_plugin", "test_mode=offset\ntest_reject=1\n");
+    wait_for_loader();
+    out = play(c, nullptr);
+    int diffs = count_diffs(k, out, ref, 0, last);
+    snprintf(detail, sizeof(detail), "%d frames differ from built-in", diffs);
+    failures += report("reject", diffs == 0, detail);
+
+    write_plugin_config(c, "pen_test_plugin", "test_mode=slow\nplugin_budget_us=100\n");
+    wait_for_loader();
+    out = play(c, nullptr);
+    diffs = count_diffs(k, out, ref, last, last);
+    snprintf(detail, sizeof(detail), "%d frames of the last stroke differ from built-in", diffs);
+    failures += report("slow", diffs == 0, detail);
+
+    write_plugin_config(c, nullptr, "");
+    wait_for_loader();
+    out = play(c, nullptr);
+    diffs = count_diffs(k, out, ref, 0, last);
+    snprintf(detail, sizeof(detail), "%d frames differ from built-in", diffs);
+    failures += report("unload", diffs == 0, detail);
+
+    restore_stderr(saved_err);
+    scratch_remove(c.scratch);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * pen_reader — xochitl-like consumer of a pen event device
+ *
+ * Run with libstabilizer.so preloaded. Opens the device with open()
+ * (so the library's device detection is exercised), then sits in a
+ * poll() loop doing fixed- or random-sized read()s with occasional
+ * stalls, the way a busy UI thread would. For every SYN_REPORT it
+ * logs the receive time and the pen state after the frame:
+ *
+ *   <frame> <recv_ns CLOCK_MONOTONIC> <x> <y> <pressure> <split>
+ *
+ * split=1 means the frame's events arrived across more than one
+ * read(), so the library could not rewrite the earlier part, or that
+ * the pen state still holds an axis value from such a frame.
+ *
+ * Usage: pen_reader <device> <log> [options]
+ *   --read-events N   events per read() buffer (default 32)
+ *   --random-reads    read a random 1..N events each time
+ *   --stall-prob P    chance per wakeup of stalling (default 0)
+ *   --stall-ms M      stall length in ms (default 8)
+ *   --frames N        exit after N frames (default: run to EOF)
+ *   --idle-ms T       exit after T ms without data once started (default 1000)
+ *   --seed S          RNG seed for reads and stalls
+ *
+ * Prints "ready" on stdout once the device is open.
+ *
+ * MIT License
+ */
+
+#include "pen_recording.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <vector>
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <device> <log> [options]\n", argv[0]);
+        return 2;
+    }
+    const char* device = argv[1];
+    const char* log_path = argv[2];
+    int read_events = 32;
+    bool random_reads = false;
+    double stall_prob = 0;
+    int stall_ms = 8;
+    long max_frames = -1;
+    int idle_ms = 1000;
+    uint32_t rng = 1;
+
+    for (int i = 3; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : "";
+        if (strcmp(a, "--read-events") == 0) { read_events = atoi(v); i++; }
+        else if (strcmp(a, "--random-reads") == 0) random_reads = true;
+        else if (strcmp(a, "--stall-prob") == 0) { stall_prob = atof(v); i++; }
+        else if (strcmp(a, "--stall-ms") == 0) { stall_ms = atoi(v); i++; }
+        else if (strcmp(a, "--frames") == 0) { max_frames = atol(v); i++; }
+        else if (strcmp(a, "--idle-ms") == 0) { idle_ms = atoi(v); i++; }
+        else if (strcmp(a, "--seed") == 0) { rng = (uint32_t)atol(v); i++; }
+        else { fprintf(stderr, "[reader] unknown option %s\n", a); return 2; }
+    }
+    if (read_events < 1) read_events = 1;
+
+    int fd = open(device, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        perror("[reader] open");
+        return 1;
+    }
+    FILE* log = fopen(log_path, "w");
+    if (!log) {
+        perror("[reader] log");
+        return 1;
+    }
+    printf("ready\n");
+    fflush(stdout);
+
+    // Heap buffer: a fixed-size stack array lets _FORTIFY_SOURCE route
+    // variable-length reads to __read_chk, bypassing the read() hook.
+    std::vector<input_event> buf(read_events);
+    PenSample state;
+    long frames = 0;
+    bool frame_open = false;   // events of the current frame seen
+    bool frame_split = false;
+    bool stale[3] = {false, false, false};   // x, y, pressure from a split frame
+    bool started = false;
+    uint64_t last_data = mono_ns();
+
+    while (max_frames < 0 || frames < max_frames) {
+        pollfd pfd = { fd, POLLIN, 0 };
+        int pr = poll(&pfd, 1, 50);
+        if (pr < 0) {
+            perror("[reader] poll");
+            break;
+        }
+        if (pr == 0) {
+            if (started && (mono_ns() - last_data) / 1000000 > (uint64_t)idle_ms) break;
+            continue;
+        }
+        if (stall_prob > 0 && (synth_noise(rng) + 1) / 2 < stall_prob)
+            usleep(stall_ms * 1000);
+
+        int want = random_reads
+            ? 1 + (int)((synth_noise(rng) + 1) / 2 * (read_events - 1) + 0.5)
+            : read_events;
+        ssize_t n = read(fd, buf.data(), want * sizeof(input_event));
+        uint64_t now = mono_ns();
+        if (n == 0) break;   // pipe transport: writer closed
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) continue;
+            perror("[reader] read");
+            break;
+        }
+        started = true;
+        last_data = now;
+
+        // A frame still open from the previous read is now split
+        if (frame_open) frame_split = true;
+
+        size_t count = n / sizeof(input_event);
+        size_t frame_begin = 0;
+        for (size_t i = 0; i < count; i++) {
+            const input_event& ev = buf[i];
+            if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+                apply_frame(state, &buf[frame_begin], i - frame_begin);
+                if (frame_split) {
+                    stale[0] = stale[1] = stale[2] = true;
+                } else {
+                    for (size_t k = frame_begin; k < i; k++) {
+                        if (buf[k].type != EV_ABS) continue;
+                        if (buf[k].code == ABS_X) stale[0] = false;
+                        else if (buf[k].code == ABS_Y) stale[1] = false;
+                        else if (buf[k].code == ABS_PRESSURE) stale[2] = false;
+                    }
+                }
+                bool tainted = stale[0] || stale[1] || stale[2];
+                fprintf(log, "%ld %llu %d %d %d %d\n", frames,
+                        (unsigned long long)now, state.x, state.y,
+                        state.pressure, tainted ? 1 : 0);
+                frames++;
+                frame_begin = i + 1;
+                frame_open = false;
+                frame_split = false;
+            } else {
+                frame_open = true;
+            }
+        }
+        apply_frame(state, &buf[frame_begin], count - frame_begin);
+    }
+
+    fclose(log);
+    close(fd);
+    return 0;
+}
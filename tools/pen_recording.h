@@ -0,0 +1,314 @@
+/*
+ * pen_recording.h — Shared helpers for the host-side tools
+ *
+ * A recording is a raw stream of struct input_event, exactly what
+ * `cat /dev/input/event2` produces on the device:
+ *
+ *   ssh root@10.11.99.1 'cat /dev/input/event2' > stroke.ev
+ *
+ * When no recording is given the tools synthesize one (hover-in,
+ * jittery curved strokes, lift) at a configurable report rate.
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// A frame is the run of events up to and including a SYN_REPORT.
+struct PenFrame {
+    size_t begin = 0, end = 0;   // [begin, end) into the event vector
+    double t = 0;                // event timestamp, seconds
+};
+
+static inline double event_time(const input_event& ev) {
+    return ev.time.tv_sec + ev.time.tv_usec / 1e6;
+}
+
+static inline void set_event_time(input_event& ev, double t) {
+    ev.time.tv_sec = (time_t)t;
+    ev.time.tv_usec = (suseconds_t)((t - (double)ev.time.tv_sec) * 1e6);
+}
+
+static inline uint64_t mono_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline bool load_recording(const char* path, std::vector<input_event>& out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    input_event ev;
+    while (fread(&ev, sizeof(ev), 1, f) == 1) out.push_back(ev);
+    fclose(f);
+    return true;
+}
+
+static inline std::vector<PenFrame> split_frames(const std::vector<input_event>& evs) {
+    std::vector<PenFrame> frames;
+    size_t begin = 0;
+    for (size_t i = 0; i < evs.size(); i++) {
+        if (evs[i].type == EV_SYN && evs[i].code == SYN_REPORT) {
+            PenFrame f;
+            f.begin = begin;
+            f.end = i + 1;
+            f.t = event_time(evs[i]);
+            frames.push_back(f);
+            begin = i + 1;
+        }
+    }
+    return frames;
+}
+
+// Mirror what the kernel input core does before events reach evdev:
+// drop EV_ABS/EV_KEY events that repeat the current value, and drop
+// frames left with nothing but their SYN_REPORT. Playback through
+// uinput applies this anyway; applying it up front keeps the pipe
+// transport and the reference run frame-for-frame comparable.
+static inline std::vector<input_event> normalize_like_input_core(
+        const std::vector<input_event>& in) {
+    std::vector<input_event> out;
+    int abs_val[ABS_CNT] = {0};
+    int key_val[KEY_CNT] = {0};
+    size_t frame_begin = 0;
+    for (const input_event& ev : in) {
+        if (ev.type == EV_ABS && ev.code < ABS_CNT) {
+            if (abs_val[ev.code] == ev.value) continue;
+            abs_val[ev.code] = ev.value;
+        } else if (ev.type == EV_KEY && ev.code < KEY_CNT) {
+            if (key_val[ev.code] == ev.value) continue;
+            key_val[ev.code] = ev.value;
+        } else if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+            if (out.size() == frame_begin) continue;
+            out.push_back(ev);
+            frame_begin = out.size();
+            continue;
+        } else {
+            continue;   // EV_MSC etc. are not part of the pen model
+        }
+        out.push_back(ev);
+    }
+    out.resize(frame_begin);   // drop an unterminated tail
+    return out;
+}
+
+struct SynthParams {
+    double rate_hz = 500.0;     // report rate
+    double stroke_ms = 400.0;   // pen-down time per stroke
+    double hover_ms = 60.0;     // hover before and after each stroke
+    double hover_drift = 0.0;   // hover-in approach speed, units per report
+    int strokes = 3;
+    double jitter = 4.0;        // +/- position noise per report
+    uint32_t seed = 1;
+};
+
+// Small deterministic LCG so generated corpora are reproducible.
+static inline double synth_noise(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return ((state >> 8) / 16777216.0) * 2.0 - 1.0;
+}
+
+static inline std::vector<input_event> synthesize_strokes(const SynthParams& p) {
+    std::vector<input_event> out;
+    uint32_t rng = p.seed;
+    double t = 1000.0;
+    double dt = 1.0 / p.rate_hz;
+
+    auto emit = [&](uint16_t type, uint16_t code, int value) {
+        input_event ev;
+        memset(&ev, 0, sizeof(ev));
+        set_event_time(ev, t);
+        ev.type = type; ev.code = code; ev.value = value;
+        out.push_back(ev);
+    };
+    auto syn = [&]() { emit(EV_SYN, SYN_REPORT, 0); t += dt; };
+
+    for (int s = 0; s < p.strokes; s++) {
+        // Ranges follow the observed Elan values in docs/ARCHITECTURE.md
+        double cx = 7200 + 150 * s, cy = 11800 + 120 * s;
+        double r = 300 + 40 * s;
+        int hover_frames = (int)(p.hover_ms / 1000.0 * p.rate_hz);
+        int stroke_frames = (int)(p.stroke_ms / 1000.0 * p.rate_hz);
+
+        emit(EV_KEY, BTN_TOOL_PEN, 1);
+        for (int i = 0; i < hover_frames; i++) {
+            emit(EV_ABS, ABS_X, (int)(cx + r + p.hover_drift * (hover_frames - i)));
+            emit(EV_ABS, ABS_Y, (int)(cy - p.hover_drift * (hover_frames - i)));
+            emit(EV_ABS, ABS_DISTANCE, 19550 - i * 10);
+            emit(EV_ABS, ABS_TILT_X, 600);
+            emit(EV_ABS, ABS_TILT_Y, -900);
+            syn();
+        }
+        for (int i = 0; i < stroke_frames; i++) {
+            // Curved stroke with speed changes plus a few units of jitter
+            double u = (double)i / stroke_frames;
+            double a = 2 * M_PI * (u + 0.15 * sin(3 * M_PI * u));
+            double jx = p.jitter * synth_noise(rng), jy = p.jitter * synth_noise(rng);
+            emit(EV_ABS, ABS_X, (int)(cx + r * cos(a) * (1 - 0.3 * u) + jx));
+            emit(EV_ABS, ABS_Y, (int)(cy + r * sin(a) * (1 - 0.3 * u) + jy));
+            emit(EV_ABS, ABS_PRESSURE, 900 + (int)(1200 * sin(M_PI * u)));
+            emit(EV_ABS, ABS_TILT_X, 600 + (int)(20 * synth_noise(rng)));
+            syn();
+        }
+        emit(EV_ABS, ABS_PRESSURE, 0);
+        syn();
+        for (int i = 0; i < hover_frames; i++) {
+            emit(EV_ABS, ABS_DISTANCE, 18800 + i * 10);
+            syn();
+        }
+        emit(EV_KEY, BTN_TOOL_PEN, 0);
+        syn();
+        t += 0.25;   // gap between strokes
+    }
+    return out;
+}
+
+// Pen state as a reader (xochitl) would hold it after applying a frame.
+struct PenSample {
+    int x = 0, y = 0, pressure = 0;
+};
+
+static inline void apply_frame(PenSample& s, const input_event* evs, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (evs[i].type != EV_ABS) continue;
+        if (evs[i].code == ABS_X) s.x = evs[i].value;
+        else if (evs[i].code == ABS_Y) s.y = evs[i].value;
+        else if (evs[i].code == ABS_PRESSURE) s.pressure = evs[i].value;
+    }
+}
+
+// libstabilizer.so loaded into the tool's own process. Its open() and
+// read() hooks are called directly and reach libc through RTLD_NEXT;
+// the tool's own I/O is unaffected because the library is RTLD_LOCAL.
+struct StabilizerLib {
+    void* handle = nullptr;
+    int (*open)(const char*, int, ...) = nullptr;
+    ssize_t (*read)(int, void*, size_t) = nullptr;
+};
+
+static inline bool load_stabilizer(const char* path, StabilizerLib& lib) {
+    lib.handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!lib.handle) {
+        fprintf(stderr, "dlopen %s: %s\n", path, dlerror());
+        return false;
+    }
+    lib.open = (int (*)(const char*, int, ...))dlsym(lib.handle, "open");
+    lib.read = (ssize_t (*)(int, void*, size_t))dlsym(lib.handle, "read");
+    return lib.open && lib.read;
+}
+
+static inline bool write_config(const char* path, const char* algorithm, double strength) {
+    FILE* c = fopen(path, "w");
+    if (!c) return false;
+    fprintf(c, "algorithm=%s\nstrength=%.3f\n", algorithm, strength);
+    fclose(c);
+    return true;
+}
+
+// Scratch directory under /tmp holding the pen device file and config
+// the in-process library is pointed at.
+struct ScratchDevice {
+    std::string dir, device, config;
+};
+
+static inline bool scratch_create(ScratchDevice& s, const char* tool) {
+    std::string tmpl = std::string("/tmp/") + tool + ".XXXXXX";
+    std::vector<char> path(tmpl.begin(), tmpl.end());
+    path.push_back('\0');
+    if (!mkdtemp(path.data())) return false;
+    s.dir = path.data();
+    s.device = s.dir + "/pen.ev";
+    s.config = s.dir + "/stabilizer.conf";
+    setenv("STABILIZER_PEN_DEVICE", s.device.c_str(), 1);
+    setenv("STABILIZER_CONFIG", s.config.c_str(), 1);
+    return true;
+}
+
+static inline bool scratch_write_events(const ScratchDevice& s, const std::vector<input_event>& evs) {
+    FILE* f = fopen(s.device.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(evs.data(), sizeof(input_event), evs.size(), f) == evs.size();
+    return fclose(f) == 0 && ok;
+}
+
+// Removes the directory and every file the tool left in it
+static inline void scratch_remove(const ScratchDevice& s) {
+    if (DIR* d = opendir(s.dir.c_str())) {
+        while (dirent* e = readdir(d)) {
+            if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0)
+                unlink((s.dir + "/" + e->d_name).c_str());
+        }
+        closedir(d);
+    }
+    rmdir(s.dir.c_str());
+}
+
+// The library logs to stderr on every open(); send that to a file (or
+// /dev/null) so reports stay readable. Returns the fd restore_stderr()
+// puts back.
+static inline int redirect_stderr(const char* path = "/dev/null") {
+    fflush(stderr);
+    int saved = dup(2);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) { dup2(fd, 2); close(fd); }
+    return saved;
+}
+
+static inline void restore_stderr(int saved) {
+    fflush(stderr);
+    if (saved < 0) return;
+    dup2(saved, 2);
+    close(saved);
+}
+
+// Plays frames [first, last) through the hook on an open fd,
+// frames_per_read frames per read() (one, as xochitl reads at 500Hz,
+// by default). When out is given it receives the reader's pen state
+// after each frame, indexed by frame, carried on from out[first - 1].
+// Returns false on a short read.
+static inline bool play_frames(const StabilizerLib& lib, int fd,
+                               const std::vector<PenFrame>& frames,
+                               std::vector<PenSample>* out = nullptr,
+                               size_t first = 0, size_t last = SIZE_MAX,
+                               size_t frames_per_read = 1) {
+    if (last > frames.size()) last = frames.size();
+    if (frames_per_read < 1) frames_per_read = 1;
+    PenSample state;
+    if (out) {
+        out->resize(frames.size());
+        if (first > 0) state = (*out)[first - 1];
+    }
+    std::vector<input_event> buf;
+    for (size_t f = first; f < last; f += frames_per_read) {
+        size_t end_frame = f + frames_per_read < last ? f + frames_per_read : last;
+        size_t begin = frames[f].begin;
+        buf.resize(frames[end_frame - 1].end - begin);
+        size_t bytes = buf.size() * sizeof(input_event);
+        if (lib.read(fd, buf.data(), bytes) != (ssize_t)bytes) return false;
+        if (!out) continue;
+        for (size_t i = f; i < end_frame; i++) {
+            apply_frame(state, &buf[frames[i].begin - begin], frames[i].end - frames[i].begin);
+            (*out)[i] = state;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,282 @@
+/*
+ * pen_stress — High-rate stress benchmark for the read() hook
+ *
+ * Drives libstabilizer.so in-process with synthetic strokes at the
+ * rMPP's 500Hz and at 1, 2 and 4kHz (USI pens and external tablets),
+ * one frame per read() and in large batches (xochitl under load).
+ * For every algorithm it reports:
+ *
+ *   ns/frame  hook cost per frame: read() through the hook minus the
+ *             same reads straight to libc, best of several passes
+ *   lag       mean distance between raw and filtered pen-down points;
+ *             stays level across rates while history covers the
+ *             filter's time window
+ *   step      largest move between consecutive pen-down frames, output
+ *             then raw, on the same strokes with jitter
+ *
+ * and fails when per-frame cost at a high rate exceeds --max-ratio
+ * times the 500Hz cost, when lag drifts from the 500Hz value by more
+ * than --lag-tolerance, when the output ever moves over 10% further in
+ * one frame than the pen did in any frame (a jump no smoothing should
+ * make), or when resident memory grows during the run.
+ *
+ * A second table pins 500Hz lag at strengths 0.2, 0.5 and 0.8 to the
+ * values the filters were tuned to on the rMPP, and fails when one
+ * moves by more than --pin-tolerance. Matching across rates alone
+ * would pass a retune that shifts every rate together.
+ *
+ * Usage: pen_stress [--lib PATH] [--batch N] [--passes N]
+ *                   [--max-ratio R] [--lag-tolerance F] [--pin-tolerance F]
+ *
+ * MIT License
+ */
+
+#include "pen_recording.h"
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static const char* ALGORITHMS[] = {
+    "moving_avg", "gaussian", "string_pull", "one_euro", "bezier"
+};
+static const double RATES[] = { 500, 1000, 2000, 4000 };
+
+// 500Hz lag on the jitter-free strokes of run(), at PIN_STRENGTHS.
+// moving_avg, gaussian, string_pull and one_euro are the original
+// filters; bezier is as introduced.
+static const double PIN_STRENGTHS[] = { 0.2, 0.5, 0.8 };
+struct PinnedLag {
+    const char* algorithm;
+    double lag[3];
+};
+static const PinnedLag PINNED_LAG[] = {
+    { "moving_avg",  {  45.6,  92.1, 127.8 } },
+    { "gaussian",    {  68.5, 119.9, 156.5 } },
+    { "string_pull", { 257.5, 393.0, 452.6 } },
+    { "one_euro",    {  35.8,  24.7,  19.6 } },
+    { "bezier",      {   5.5,   9.7,  14.4 } },
+};
+
+struct RunResult {
+    double ns_per_frame = 0;
+    double lag = 0;
+    double step = 0, raw_step = 0;
+};
+
+static long rss_kb() {
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(f);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Time one pass over the file in chunks of `batch` frames. With the
+// hook, also accumulate lag against the raw stream.
+static uint64_t timed_pass(const StabilizerLib& lib, bool hooked, const char* path,
+                           const std::vector<input_event>& evs,
+                           const std::vector<PenFrame>& frames, size_t batch,
+                           std::vector<input_event>& buf, double* lag) {
+    int fd = hooked ? lib.open(path, O_RDONLY) : open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    PenSample raw, out;
+    double lag_sum = 0;
+    size_t lag_n = 0;
+    uint64_t total = 0;
+    for (size_t f = 0; f < frames.size(); f += batch) {
+        size_t last = (f + batch < frames.size() ? f + batch : frames.size()) - 1;
+        size_t begin = frames[f].begin, end = frames[last].end;
+        size_t bytes = (end - begin) * sizeof(input_event);
+
+        uint64_t t0 = mono_ns();
+        ssize_t n = hooked ? lib.read(fd, buf.data(), bytes) : read(fd, buf.data(), bytes);
+        total += mono_ns() - t0;
+        if (n != (ssize_t)bytes) break;
+
+        if (!lag) continue;
+        for (size_t k = f; k <= last; k++) {
+            size_t off = frames[k].begin - begin;
+            size_t len = frames[k].end - frames[k].begin;
+            apply_frame(raw, &evs[frames[k].begin], len);
+            apply_frame(out, &buf[off], len);
+            if (raw.pressure >= 50) {
+                lag_sum += hypot(out.x - raw.x, out.y - raw.y);
+                lag_n++;
+            }
+        }
+    }
+    close(fd);
+    if (lag) *lag = lag_n ? lag_sum / lag_n : 0;
+    return total;
+}
+
+// Largest per-frame move of the output and of the raw pen over the
+// pen-down frames of jittered strokes
+static void largest_steps(const StabilizerLib& lib, const ScratchDevice& scratch,
+                          SynthParams sp, double* step, double* raw_step) {
+    sp.jitter = 4.0;
+    std::vector<input_event> evs = normalize_like_input_core(synthesize_strokes(sp));
+    std::vector<PenFrame> frames = split_frames(evs);
+    scratch_write_events(scratch, evs);
+
+    *step = *raw_step = 0;
+    int fd = lib.open(scratch.device.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    std::vector<PenSample> out;
+    bool ok = play_frames(lib, fd, frames, &out);
+    close(fd);
+    if (!ok) return;
+
+    // Input core drops an axis that did not change, and the hook cannot
+    // add it back, so a lagging filter's motion on that axis shows up a
+    // frame late. Only steps between frames carrying both axes count.
+    PenSample raw, prev;
+    bool both = false;
+    for (size_t i = 0; i < frames.size(); i++) {
+        bool prev_both = both;
+        int axes = 0;
+        for (size_t k = frames[i].begin; k < frames[i].end; k++)
+            if (evs[k].type == EV_ABS && (evs[k].code == ABS_X || evs[k].code == ABS_Y)) axes++;
+        both = axes == 2;
+        prev = raw;
+        apply_frame(raw, &evs[frames[i].begin], frames[i].end - frames[i].begin);
+        if (!both || !prev_both || raw.pressure < 50 || prev.pressure < 50) continue;
+        *raw_step = std::max(*raw_step, hypot(raw.x - prev.x, raw.y - prev.y));
+        *step = std::max(*step, hypot(out[i].x - out[i - 1].x, out[i].y - out[i - 1].y));
+    }
+}
+
+static RunResult run(const StabilizerLib& lib, const ScratchDevice& scratch,
+                     double rate, size_t batch, int passes) {
+    SynthParams sp;
+    sp.rate_hz = rate;
+    sp.strokes = 5;
+    sp.jitter = 0;   // lag is only comparable across rates without noise
+    std::vector<input_event> evs = normalize_like_input_core(synthesize_strokes(sp));
+    std::vector<PenFrame> frames = split_frames(evs);
+
+    scratch_write_events(scratch, evs);
+    const char* path = scratch.device.c_str();
+
+    std::vector<input_event> buf(evs.size());
+    RunResult r;
+    uint64_t best_hook = UINT64_MAX, best_raw = UINT64_MAX;
+    for (int p = 0; p < passes; p++) {
+        uint64_t h = timed_pass(lib, true, path, evs, frames, batch, buf,
+                                p == 0 ? &r.lag : nullptr);
+        uint64_t w = timed_pass(lib, false, path, evs, frames, batch, buf, nullptr);
+        if (h < best_hook) best_hook = h;
+        if (w < best_raw) best_raw = w;
+    }
+    double overhead = best_hook > best_raw ? (double)(best_hook - best_raw) : 0;
+    r.ns_per_frame = overhead / frames.size();
+    largest_steps(lib, scratch, sp, &r.step, &r.raw_step);
+    return r;
+}
+
+int main(int argc, char** argv) {
+    std::string lib_path = "build/host/libstabilizer.so";
+    size_t big_batch = 128;
+    int passes = 5;
+    double max_ratio = 3.0;
+    double lag_tolerance = 0.5;
+    double pin_tolerance = 0.1;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : "";
+        if (a == "--lib") { lib_path = v; i++; }
+        else if (a == "--batch") { big_batch = (size_t)atol(v); i++; }
+        else if (a == "--passes") { passes = atoi(v); i++; }
+        else if (a == "--max-ratio") { max_ratio = atof(v); i++; }
+        else if (a == "--lag-tolerance") { lag_tolerance = atof(v); i++; }
+        else if (a == "--pin-tolerance") { pin_tolerance = atof(v); i++; }
+        else {
+            fprintf(stderr, "usage: %s [--lib PATH] [--batch N] [--passes N] "
+                            "[--max-ratio R] [--lag-tolerance F] [--pin-tolerance F]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (big_batch < 1) big_batch = 1;
+    if (passes < 1) passes = 1;
+
+    StabilizerLib lib;
+    if (!load_stabilizer(lib_path.c_str(), lib)) return 1;
+
+    ScratchDevice scratch;
+    if (!scratch_create(scratch, "pen_stress")) return 1;
+    const char* conf = scratch.config.c_str();
+
+    // The library logs config on every open(); keep the table readable
+    int saved_err = redirect_stderr();
+
+    // Warm up once so first-touch of the library's state isn't counted
+    write_config(conf, "gaussian", 0.5);
+    run(lib, scratch, 4000, 1, 1);
+    long rss_before = rss_kb();
+
+    int failures = 0;
+    const size_t batches[] = { 1, big_batch };
+    printf("%-12s %6s %6s %10s %8s %13s\n", "algorithm", "rate", "batch", "ns/frame", "lag", "step");
+    for (const char* alg : ALGORITHMS) {
+        write_config(conf, alg, 0.5);
+        for (size_t batch : batches) {
+            RunResult base;
+            for (double rate : RATES) {
+                RunResult r = run(lib, scratch, rate, batch, passes);
+                if (rate == RATES[0]) base = r;
+
+                const char* flag = "";
+                // Sub-100ns differences are timer noise, not scaling
+                if (rate != RATES[0] && r.ns_per_frame > 100
+                    && r.ns_per_frame > max_ratio * base.ns_per_frame) {
+                    flag = "  <- cost scales with rate";
+                    failures++;
+                } else if (rate != RATES[0]
+                           && fabs(r.lag - base.lag) > lag_tolerance * base.lag + 2.0) {
+                    flag = "  <- lag depends on rate";
+                    failures++;
+                } else if (r.step > 1.1 * r.raw_step + 1.0) {
+                    // A lagging filter catching up can briefly outpace
+                    // the pen by a few percent (1€ at 500Hz as tuned); a
+                    // jump between curves is a multiple of it. One unit
+                    // covers rounding the output to integers.
+                    flag = "  <- output jumps past the pen";
+                    failures++;
+                }
+                printf("%-12s %6.0f %6zu %10.1f %8.1f %6.1f/%6.1f%s\n",
+                       alg, rate, batch, r.ns_per_frame, r.lag, r.step, r.raw_step, flag);
+            }
+        }
+    }
+
+    printf("\n%-12s %8s %8s %8s\n", "500Hz lag", "strength", "lag", "expected");
+    for (const PinnedLag& pin : PINNED_LAG) {
+        for (size_t i = 0; i < sizeof(PIN_STRENGTHS) / sizeof(PIN_STRENGTHS[0]); i++) {
+            write_config(conf, pin.algorithm, PIN_STRENGTHS[i]);
+            RunResult r = run(lib, scratch, RATES[0], 1, 1);
+            const char* flag = "";
+            if (fabs(r.lag - pin.lag[i]) > pin_tolerance * pin.lag[i] + 1.0) {
+                flag = "  <- 500Hz lag moved from its tuning";
+                failures++;
+            }
+            printf("%-12s %8.1f %8.1f %8.1f%s\n",
+                   pin.algorithm, PIN_STRENGTHS[i], r.lag, pin.lag[i], flag);
+        }
+    }
+
+    long rss_after = rss_kb();
+    restore_stderr(saved_err);
+
+    printf("rss: %ld kB -> %ld kB\n", rss_before, rss_after);
+    if (rss_after - rss_before > 256) {
+        printf("resident memory grew during the run\n");
+        failures++;
+    }
+    scratch_remove(scratch);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * pen_test_plugin — Misbehaving filter plugin for pen_plugin_check
+ *
+ * test_mode picks the behaviour:
+ *   offset   shift x by test_offset (default 1000), so the check can
+ *            tell which plugin instance filtered a frame
+ *   segv     write through a null pointer
+ *   slow     spin for 1ms per frame
+ *   error    return an error from process()
+ *   nan      return NaN coordinates
+ *   late     behave as offset until test_fail_after (default 20)
+ *            pen-down points have been filtered, then return an error,
+ *            so the plugin is dropped partway through a stroke
+ *
+ * test_reject=<anything> makes params() reject that line.
+ *
+ * MIT License
+ */
+
+#include "../src/stabilizer_plugin.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum { MODE_OFFSET, MODE_SEGV, MODE_SLOW, MODE_ERROR, MODE_NAN, MODE_LATE };
+
+struct test_plugin {
+    int mode;
+    double offset;
+    int fail_after;
+    int pressed;        // pen-down points filtered so far
+};
+
+static void* test_init(void) {
+    struct test_plugin* t = (struct test_plugin*)calloc(1, sizeof(struct test_plugin));
+    if (t) {
+        t->offset = 1000;
+        t->fail_after = 20;
+    }
+    return t;
+}
+
+static int test_params(void* self, const char* key, const char* value) {
+    struct test_plugin* t = (struct test_plugin*)self;
+    if (strcmp(key, "test_mode") == 0) {
+        if (strcmp(value, "segv") == 0) t->mode = MODE_SEGV;
+        else if (strcmp(value, "slow") == 0) t->mode = MODE_SLOW;
+        else if (strcmp(value, "error") == 0) t->mode = MODE_ERROR;
+        else if (strcmp(value, "nan") == 0) t->mode = MODE_NAN;
+        else if (strcmp(value, "late") == 0) t->mode = MODE_LATE;
+        else t->mode = MODE_OFFSET;
+    } else if (strcmp(key, "test_offset") == 0) {
+        t->offset = atof(value);
+    } else if (strcmp(key, "test_fail_after") == 0) {
+        t->fail_after = atoi(value);
+    } else if (strcmp(key, "test_reject") == 0) {
+        return 1;
+    }
+    return 0;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int test_process(void* self, stabilizer_point* pts, size_t n) {
+    struct test_plugin* t = (struct test_plugin*)self;
+    switch (t->mode) {
+        case MODE_SEGV: {
+            volatile int* p = NULL;
+            *p = 1;
+            break;
+        }
+        case MODE_SLOW: {
+            double end = now_s() + 0.001 * n;
+            while (now_s() < end) {}
+            break;
+        }
+        case MODE_ERROR:
+            return 1;
+        case MODE_NAN:
+            for (size_t i = 0; i < n; i++) pts[i].x = NAN;
+            break;
+        case MODE_LATE:
+            if (t->pressed >= t->fail_after) return 1;
+            for (size_t i = 0; i < n; i++) {
+                if (pts[i].pressure >= 50) t->pressed++;
+                pts[i].x += t->offset;
+            }
+            break;
+        default:
+            for (size_t i = 0; i < n; i++) pts[i].x += t->offset;
+            break;
+    }
+    return 0;
+}
+
+static void test_reset(void* self) {
+    (void)self;
+}
+
+static void test_destroy(void* self) {
+    free(self);
+}
+
+static const stabilizer_plugin test_plugin = {
+    STABILIZER_PLUGIN_ABI, sizeof(stabilizer_plugin), "pen_plugin_check test plugin",
+    test_init, test_params, test_process, test_reset, test_destroy
+};
+
+const stabilizer_plugin* stabilizer_plugin_v1(void) {
+    return &test_plugin;
+}
@@ -0,0 +1,349 @@
+/*
+ * pen_train — Fit the lag predictor table from recorded strokes
+ *
+ * Runs the corpus through libstabilizer.so with the chosen algorithm
+ * (prediction off) and collects, for every pen-down frame, the raw
+ * position and the filtered one. It then fits by least squares the
+ * coefficients c that best predict the filter's lag from the last N
+ * filtered deltas:
+ *
+ *   raw(t) - filtered(t)  ~=  sum_k c[k] * delta_k * dt_scale_k
+ *
+ * where delta_k is the filtered movement k frames back. One set of
+ * coefficients is shared by both axes. Every fourth stroke is held out
+ * for evaluation. The report compares no prediction, the best
+ * constant-velocity extrapolation (the 1-tap fit) and the N-tap fit.
+ *
+ * A table whose total gain leads past the filter's lag (string_pull,
+ * whose lag is a distance, fits gains in the hundreds of frames) is not
+ * written. Otherwise the corpus is replayed through the hook with the
+ * table loaded, and pen_train fails and removes the table if the hook's
+ * residual is more than 10% worse than the fit's, or if the table moved
+ * any hover frame (the hook only predicts pen-down frames).
+ *
+ * Usage: pen_train [--lib PATH] [--algorithm NAME] [--strength S]
+ *                  [--taps N] [--out FILE] [recording.ev ...]
+ *
+ * --algorithm defaults to one_euro; string_pull is always refused.
+ *
+ * Install the table on the device as /home/root/.stabilizer.predict
+ * and set prediction=true in the config.
+ *
+ * MIT License
+ */
+
+#include "pen_recording.h"
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static const int MAX_TAPS = 8;   // MAX_PREDICT_TAPS in src/stabilizer.cpp
+static const double NOMINAL_RATE_HZ = 500.0;
+static const int MAX_HORIZON = 100;        // frames searched for the filter's lag
+static const double GAIN_SLACK = 1.25;     // lead allowed past the lag, x horizon + 1 frame
+static const double HOOK_TOLERANCE = 0.10; // hook check vs fitted residual
+
+struct TrainFrame {
+    PenSample raw, out;
+    double t = 0;
+};
+
+typedef std::vector<TrainFrame> Stroke;
+
+// Must match predict_dt_scale() in src/stabilizer.cpp
+static double predict_dt_scale(double dt) {
+    double nominal = 1.0 / NOMINAL_RATE_HZ;
+    if (dt <= 0) return 1.0;
+    double scale = nominal / dt;
+    if (scale < 0.25) scale = 0.25;
+    if (scale > 4.0) scale = 4.0;
+    return scale;
+}
+
+// Runs every recording through the hook one frame per read() and
+// splits the result into pen-down strokes. If hover is given, the
+// positions hover frames carry are appended to it in order.
+static std::vector<Stroke> collect(const StabilizerLib& lib, const ScratchDevice& scratch,
+                                   const std::vector<std::vector<input_event>>& corpus,
+                                   std::vector<int>* hover = nullptr) {
+    std::vector<Stroke> strokes;
+    for (const std::vector<input_event>& raw_events : corpus) {
+        std::vector<input_event> evs = normalize_like_input_core(raw_events);
+        std::vector<PenFrame> frames = split_frames(evs);
+        if (!scratch_write_events(scratch, evs)) continue;
+
+        int fd = lib.open(scratch.device.c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        std::vector<PenSample> out;
+        bool ok = play_frames(lib, fd, frames, &out);
+        close(fd);
+        if (!ok) continue;
+
+        PenSample raw;
+        Stroke cur;
+        for (size_t i = 0; i < frames.size(); i++) {
+            const PenFrame& fr = frames[i];
+            apply_frame(raw, &evs[fr.begin], fr.end - fr.begin);
+            if (raw.pressure >= 50) {
+                TrainFrame tf;
+                tf.raw = raw; tf.out = out[i]; tf.t = fr.t;
+                cur.push_back(tf);
+                continue;
+            }
+            if (!cur.empty()) {
+                strokes.push_back(cur);
+                cur.clear();
+            }
+            if (!hover) continue;
+            for (size_t e = fr.begin; e < fr.end; e++) {
+                if (evs[e].type != EV_ABS) continue;
+                if (evs[e].code == ABS_X) hover->push_back(out[i].x);
+                else if (evs[e].code == ABS_Y) hover->push_back(out[i].y);
+            }
+        }
+        if (!cur.empty()) strokes.push_back(cur);
+    }
+    return strokes;
+}
+
+// Feature vector for frame i of a stroke (needs i >= taps)
+static void features(const Stroke& s, size_t i, int taps, double* vx, double* vy) {
+    for (int k = 0; k < taps; k++) {
+        const TrainFrame& a = s[i - k];
+        const TrainFrame& b = s[i - k - 1];
+        double scale = predict_dt_scale(a.t - b.t);
+        vx[k] = (a.out.x - b.out.x) * scale;
+        vy[k] = (a.out.y - b.out.y) * scale;
+    }
+}
+
+static bool fit(const std::vector<Stroke>& strokes, bool holdout_set, int taps, double* c) {
+    double A[MAX_TAPS][MAX_TAPS + 1] = {{0}};   // augmented normal equations
+    double vx[MAX_TAPS], vy[MAX_TAPS];
+    for (size_t si = 0; si < strokes.size(); si++) {
+        if ((si % 4 == 3) != holdout_set) continue;
+        const Stroke& s = strokes[si];
+        for (size_t i = taps; i < s.size(); i++) {
+            features(s, i, taps, vx, vy);
+            double rx = s[i].raw.x - s[i].out.x, ry = s[i].raw.y - s[i].out.y;
+            for (int r = 0; r < taps; r++) {
+                for (int k = 0; k < taps; k++) A[r][k] += vx[r] * vx[k] + vy[r] * vy[k];
+                A[r][taps] += vx[r] * rx + vy[r] * ry;
+            }
+        }
+    }
+
+    // Light ridge term keeps near-collinear taps from blowing up
+    double trace = 0;
+    for (int r = 0; r < taps; r++) trace += A[r][r];
+    if (trace <= 0) return false;
+    for (int r = 0; r < taps; r++) A[r][r] += 1e-4 * trace / taps;
+
+    // Gaussian elimination with partial pivoting
+    for (int col = 0; col < taps; col++) {
+        int piv = col;
+        for (int r = col + 1; r < taps; r++)
+            if (fabs(A[r][col]) > fabs(A[piv][col])) piv = r;
+        if (fabs(A[piv][col]) < 1e-12) return false;
+        for (int k = 0; k <= taps; k++) std::swap(A[col][k], A[piv][k]);
+        for (int r = col + 1; r < taps; r++) {
+            double m = A[r][col] / A[col][col];
+            for (int k = col; k <= taps; k++) A[r][k] -= m * A[col][k];
+        }
+    }
+    for (int r = taps - 1; r >= 0; r--) {
+        double v = A[r][taps];
+        for (int k = r + 1; k < taps; k++) v -= A[r][k] * c[k];
+        c[r] = v / A[r][r];
+    }
+    return true;
+}
+
+// The filter's lag horizon: the delay, in frames, at which the raw
+// stroke best lines up with the filtered one. A table whose total gain
+// (its lead at constant velocity) goes past it extrapolates beyond where
+// the pen has been, as a distance-based filter like string_pull invites.
+static int lag_horizon(const std::vector<Stroke>& strokes) {
+    int best = 0;
+    double best_err = -1;
+    for (int d = 0; d <= MAX_HORIZON; d++) {
+        double sum = 0;
+        size_t n = 0;
+        for (size_t si = 0; si < strokes.size(); si++) {
+            if (si % 4 == 3) continue;
+            const Stroke& s = strokes[si];
+            for (size_t i = d; i < s.size(); i++) {
+                double dx = s[i].out.x - s[i - d].raw.x, dy = s[i].out.y - s[i - d].raw.y;
+                sum += dx * dx + dy * dy;
+                n++;
+            }
+        }
+        if (n == 0) break;
+        if (best_err < 0 || sum / n < best_err) { best_err = sum / n; best = d; }
+    }
+    return best;
+}
+
+// RMS distance between raw and (filtered + prediction); taps=0 is none.
+// Frames before the deepest model's history fills are skipped so every
+// model is scored on the same frames.
+static double residual(const std::vector<Stroke>& strokes, bool holdout_set,
+                       int taps, const double* c, int skip) {
+    double sum = 0;
+    size_t n = 0;
+    double vx[MAX_TAPS], vy[MAX_TAPS];
+    for (size_t si = 0; si < strokes.size(); si++) {
+        if ((si % 4 == 3) != holdout_set) continue;
+        const Stroke& s = strokes[si];
+        for (size_t i = skip; i < s.size(); i++) {
+            double px = s[i].out.x, py = s[i].out.y;
+            if (taps > 0) {
+                features(s, i, taps, vx, vy);
+                for (int k = 0; k < taps; k++) { px += c[k] * vx[k]; py += c[k] * vy[k]; }
+            }
+            double dx = s[i].raw.x - px, dy = s[i].raw.y - py;
+            sum += dx * dx + dy * dy;
+            n++;
+        }
+    }
+    return n ? sqrt(sum / n) : 0;
+}
+
+int main(int argc, char** argv) {
+    std::string lib_path = "build/host/libstabilizer.so";
+    std::string algorithm = "one_euro";
+    std::string out_path = "stabilizer.predict";
+    double strength = 0.5;
+    int taps = 4;
+    std::vector<std::vector<input_event>> corpus;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : "";
+        if (a == "--lib") { lib_path = v; i++; }
+        else if (a == "--algorithm") { algorithm = v; i++; }
+        else if (a == "--strength") { strength = atof(v); i++; }
+        else if (a == "--taps") { taps = atoi(v); i++; }
+        else if (a == "--out") { out_path = v; i++; }
+        else if (a[0] == '-') {
+            fprintf(stderr, "usage: %s [--lib PATH] [--algorithm NAME] [--strength S] "
+                            "[--taps N] [--out FILE] [recording.ev ...]\n", argv[0]);
+            return 2;
+        } else {
+            std::vector<input_event> evs;
+            if (!load_recording(argv[i], evs)) {
+                fprintf(stderr, "cannot read %s\n", argv[i]);
+                return 1;
+            }
+            corpus.push_back(evs);
+        }
+    }
+    if (taps < 1 || taps > MAX_TAPS) {
+        fprintf(stderr, "--taps must be 1..%d\n", MAX_TAPS);
+        return 2;
+    }
+    if (corpus.empty()) {
+        // No recordings: synthetic strokes at a few seeds, for trying it out
+        for (uint32_t seed = 1; seed <= 4; seed++) {
+            SynthParams sp;
+            sp.strokes = 4;
+            sp.seed = seed;
+            sp.stroke_ms = 300 + 100 * seed;
+            sp.hover_drift = 4.0;   // a moving approach, so the hover check has teeth
+            corpus.push_back(synthesize_strokes(sp));
+        }
+    }
+
+    StabilizerLib lib;
+    if (!load_stabilizer(lib_path.c_str(), lib)) return 1;
+    ScratchDevice scratch;
+    if (!scratch_create(scratch, "pen_train")) return 1;
+    const char* conf = scratch.config.c_str();
+    setenv("STABILIZER_PREDICT", out_path.c_str(), 1);
+
+    // Keep the library's logging out of the report
+    int saved_err = redirect_stderr();
+
+    write_config(conf, algorithm.c_str(), strength);
+    std::vector<int> hover;
+    std::vector<Stroke> strokes = collect(lib, scratch, corpus, &hover);
+    bool holdout = strokes.size() >= 4;
+
+    double velocity[1] = {0}, learned[MAX_TAPS] = {0};
+    bool ok = fit(strokes, false, 1, velocity) && fit(strokes, false, taps, learned);
+
+    double gain = 0;
+    for (int k = 0; k < taps; k++) gain += learned[k];
+    int horizon = lag_horizon(strokes);
+    bool sane = fabs(gain) <= GAIN_SLACK * horizon + 1.0;
+
+    // Replay through the hook with the table in place
+    double hooked = 0;
+    size_t hover_moved = 0;
+    if (ok && sane) {
+        FILE* t = fopen(out_path.c_str(), "w");
+        if (!t) ok = false;
+        else {
+            fprintf(t, "# rmpp-stabilizer prediction table (tools/pen_train)\n");
+            fprintf(t, "algorithm=%s\nstrength=%.3f\ntaps=%d\ncoeffs=", algorithm.c_str(), strength, taps);
+            for (int k = 0; k < taps; k++) fprintf(t, "%s%.6f", k ? " " : "", learned[k]);
+            fprintf(t, "\n");
+            fclose(t);
+
+            if (FILE* c = fopen(conf, "a")) {
+                fprintf(c, "prediction=true\n");
+                fclose(c);
+            }
+            std::vector<int> replay_hover;
+            std::vector<Stroke> replay = collect(lib, scratch, corpus, &replay_hover);
+            hooked = residual(replay, holdout, 0, nullptr, taps);
+            for (size_t i = 0; i < hover.size(); i++)
+                if (i >= replay_hover.size() || replay_hover[i] != hover[i]) hover_moved++;
+        }
+    }
+
+    restore_stderr(saved_err);
+    scratch_remove(scratch);
+
+    if (!ok) {
+        fprintf(stderr, "fit failed: not enough pen-down movement in the corpus\n");
+        return 1;
+    }
+    if (!sane) {
+        fprintf(stderr, "not writing %s: gain %.1f frames is past %s's lag of %d frames;\n"
+                        "its lag does not follow velocity, so prediction cannot cancel it\n",
+                out_path.c_str(), gain, algorithm.c_str(), horizon);
+        return 1;
+    }
+
+    double none = residual(strokes, holdout, 0, nullptr, taps);
+    double vel = residual(strokes, holdout, 1, velocity, taps);
+    double lrn = residual(strokes, holdout, taps, learned, taps);
+    printf("corpus:     %zu strokes (%s)\n", strokes.size(),
+           holdout ? "every 4th held out" : "too few to hold out, scored on training set");
+    printf("algorithm:  %s strength=%.2f\n", algorithm.c_str(), strength);
+    printf("lag rms:    none=%.1f  velocity=%.1f (%.0f%% cancelled)  learned=%.1f (%.0f%% cancelled)\n",
+           none, vel, none > 0 ? 100 * (1 - vel / none) : 0,
+           lrn, none > 0 ? 100 * (1 - lrn / none) : 0);
+    printf("gain:       %.1f frames, filter lag %d frames\n", gain, horizon);
+    printf("coeffs:    ");
+    for (int k = 0; k < taps; k++) printf(" %.4f", learned[k]);
+    printf("\n");
+
+    // The hook predicts from its unrounded filter state, which also
+    // advances on axes a frame does not re-emit, while the fit only sees
+    // what a reader sees; so it may do better than the fit, never much worse.
+    // Hover frames are not fitted and must come through unpredicted
+    bool applied = hooked <= lrn * (1 + HOOK_TOLERANCE) + 0.5 && hover_moved == 0;
+    printf("hook check: %.1f with the table loaded (fit %.1f), %zu of %zu hover positions moved %s\n",
+           hooked, lrn, hover_moved, hover.size(), applied ? "ok" : "FAIL");
+    if (!applied) {
+        fprintf(stderr, "the library does not apply %s as fitted; table removed\n", out_path.c_str());
+        unlink(out_path.c_str());
+        return 1;
+    }
+    printf("wrote %s\n", out_path.c_str());
+    return 0;
+}